@@ -1,13 +1,36 @@
 #include "Agent.h"
 #include "Application.h"
 #include "ModuleNetworkManager.h"
+#include "ModuleAgentContainer.h"
+#include "Metrics.h"
+#include <atomic>
 
-uint16_t g_IdCounter = 1;
+// States with duration metrics (per agent type)
+static const int MAX_STATE_METRICS = 16;
+
+// It returns the histogram of the durations of a state (registered when first used)
+static Metrics::Id stateDurationHistogram(int agentType, int state)
+{
+	static const char *agentTypeNames[] = { "MCC", "MCP", "UCC", "UCP" };
+	static std::atomic<Metrics::Id> histogramIds[4][MAX_STATE_METRICS]; // Id + 1 (0 if not registered yet)
+
+	Metrics::Id id = histogramIds[agentType][state].load(std::memory_order_relaxed);
+	if (id == 0)
+	{
+		// Registering twice returns the same id, so threads can race here
+		std::string name = std::string("agent.") + agentTypeNames[agentType] + ".state" + std::to_string(state) + "_us";
+		id = g_Metrics.histogram(name) + 1;
+		histogramIds[agentType][state].store(id, std::memory_order_relaxed);
+	}
+	return id - 1;
+}
 
 Agent::Agent(Node *node) :
 	_destroyFlag(false),
 	_node(node),
-	_id(g_IdCounter++)
+	_id(NULL_AGENT_ID),
+	_state(0),
+	_stateSerial(0)
 {
 }
 
@@ -16,74 +39,86 @@ Agent::~Agent()
 {
 }
 
-bool Agent::sendPacketToYellowPages(OutputMemoryStream &stream)
+void Agent::setState(int state)
 {
-	// Create socket
-	TCPSocketPtr agentSocket = SocketUtil::CreateTCPSocket(SocketAddressFamily::INET);
-	if (agentSocket == nullptr) {
-		eLog << "SocketUtil::CreateTCPSocket() failed";
-		return false;
+	const auto now = std::chrono::steady_clock::now();
+
+	// The first state is set from the constructor, before the agent type is known
+	if (_stateSerial > 0 && _state >= 0 && _state < MAX_STATE_METRICS)
+	{
+		const int agentType = asMCC() ? 0 : asMCP() ? 1 : asUCC() ? 2 : 3;
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - _stateStart);
+		g_Metrics.record(stateDurationHistogram(agentType, _state), (uint64_t)elapsed.count());
 	}
 
-	// Connect to Yellow Pages
-	char addressAndPort[128];
-	sprintf_s(addressAndPort, "%s:%d", HOSTNAME_YP, LISTEN_PORT_YP);
-	SocketAddress yellowPagesAddress(addressAndPort);
-	int res = agentSocket->Connect(yellowPagesAddress);
-	if (res != NO_ERROR) {
-		eLog << "TCPSocket::Connect() failed";
-		return false;
-	}
+	_state = state;
+	_stateSerial++;
+	_stateStart = now;
+}
 
-	// Add socket to the network manager
-	App->networkManager->AddSocket(agentSocket);
+uint64_t Agent::stateElapsedMicros() const
+{
+	const auto elapsed = std::chrono::steady_clock::now() - _stateStart;
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
 
-	// Add socket to the list of sockets of this agent
-	_sockets.push_back(agentSocket);
+void Agent::setStateTimeout(unsigned int millis)
+{
+	App->agentContainer->scheduleTimeout(this, millis);
+}
 
-	// Append data
-	agentSocket->SendPacket(stream.GetBufferPtr(), stream.GetSize());
-	return true;
+bool Agent::sendPacketToYellowPages(uint16_t itemId, OutputMemoryStream &stream)
+{
+	// Registrations change the Yellow Pages, so every replica must get them
+	// Queries are answered by any replica
+	InputMemoryStream headerStream(stream.GetBufferPtr(), stream.GetSize());
+	PacketHeader packetHead;
+	packetHead.Read(headerStream);
+	const bool allReplicas =
+		packetHead.packetType == PacketType::RegisterMCC ||
+		packetHead.packetType == PacketType::UnregisterMCC;
+
+	// Packets travel through the pooled connections to the Yellow Pages
+	return App->networkManager->sendPacketToYellowPages(itemId, stream, allReplicas);
 }
 
 bool Agent::sendPacketToAgent(const std::string &ip, uint16_t port, OutputMemoryStream &stream)
 {
-	// Create socket
-	TCPSocketPtr agentSocket = SocketUtil::CreateTCPSocket(SocketAddressFamily::INET);
-	if (agentSocket == nullptr) {
-		eLog << "SocketUtil::CreateTCPSocket() failed";
-		return false;
-	}
-
-	// Connect to Yellow Pages
-	char addressAndPort[128];
-	sprintf_s(addressAndPort, "%s:%d", ip.c_str(), port);
-	SocketAddress yellowPagesAddress(addressAndPort);
-	int res = agentSocket->Connect(yellowPagesAddress);
-	if (res != NO_ERROR) {
-		eLog << "TCPSocket::Connect() failed";
-		return false;
-	}
+	// Packets travel through the pooled connection to the host of the agent
+	return App->networkManager->sendPacket(ip, port, stream);
+}
 
-	// Add socket to the network manager
-	App->networkManager->AddSocket(agentSocket);
+bool Agent::sendPacketToSocket(TCPSocketPtr socket, OutputMemoryStream &stream)
+{
+	// Replies travel through the connection the request came from
+	return App->networkManager->sendPacket(socket, stream);
+}
 
-	// Add socket to the list of sockets of this agent
-	_sockets.push_back(agentSocket);
+void Agent::postPacket(TCPSocketPtr socket, const PacketHeader &packetHeader, InputMemoryStream &stream)
+{
+	// The stream is only valid during this call, so the body is copied
+	IncomingPacket packet;
+	packet.socket = socket;
+	packet.packetHeader = packetHeader;
+	packet.data.assign(stream.GetBufferPtr() + stream.GetSize(), stream.GetBufferPtr() + stream.GetCapacity());
+	_inbox.Push(std::move(packet));
+}
 
-	// Append data
-	agentSocket->SendPacket(stream.GetBufferPtr(), stream.GetSize());
-	return true;
+void Agent::dispatchPackets()
+{
+	static const Metrics::Id dispatchTime = g_Metrics.histogram("agent.dispatch_us");
+
+	IncomingPacket packet;
+	while (_inbox.TryPop(packet))
+	{
+		ScopedTimer timer(dispatchTime);
+		InputMemoryStream stream(packet.data.data(), (uint32_t)packet.data.size());
+		OnPacketReceived(packet.socket, packet.packetHeader, stream);
+	}
 }
 
 void Agent::destroy()
 {
 	// Tell the AgentContainer to remove this Agent
 	_destroyFlag = true;
-
-	// Disconnect all sockets used by this agent
-	for (auto socket : _sockets) {
-		socket->Disconnect();
-	}
-	_sockets.clear();
 }
\ No newline at end of file
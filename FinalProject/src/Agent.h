@@ -3,6 +3,7 @@
 #include "Log.h"
 #include "Packets.h"
 #include "Node.h"
+#include <chrono>
 #include <list>
 #include <memory>
 
@@ -46,16 +47,40 @@ public:
 
 	int state() const { return _state; }
 
-	void setState(int state) { _state = state; }
+	// It changes the state (the time spent in the previous one goes to the metrics)
+	void setState(int state);
+
+	// Time since the last state change
+	uint64_t stateElapsedMicros() const;
+
+	// Number of state changes (it tells apart timeouts of old states)
+	uint32_t stateSerial() const { return _stateSerial; }
+
+	// It schedules a deadline for the current state (see OnTimeout())
+	// (it can be called from several threads)
+	void setStateTimeout(unsigned int millis);
+
+	// Function called when the deadline of the current state expires
+	// (the state did not change since setStateTimeout())
+	virtual void OnTimeout() { }
 
 
 	// Networking methods /////////////////////////////////////////////
 
 	// Packet send functions
-	bool sendPacketToYellowPages(OutputMemoryStream &stream);
+	// (packets to the YellowPages are routed to the partition of the item)
+	bool sendPacketToYellowPages(uint16_t itemId, OutputMemoryStream &stream);
 	bool sendPacketToAgent(const std::string &ip, uint16_t port, OutputMemoryStream &stream);
+	bool sendPacketToSocket(TCPSocketPtr socket, OutputMemoryStream &stream);
 
 	// Function called from ModuleNodeCluster to forward packets received from the network
+	// The packet is queued into the inbox of the agent (it can be called from any thread)
+	void postPacket(TCPSocketPtr socket, const PacketHeader &packetHeader, InputMemoryStream &stream);
+
+	// Function called from ModuleAgentContainer before update() to handle the queued packets
+	void dispatchPackets();
+
+	// Function called for each packet of the inbox
 	virtual void OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader, InputMemoryStream &stream) = 0;
 
 
@@ -74,6 +99,16 @@ private:
 
 	bool _destroyFlag; /**< Whether or not the agent finished and should be destroyed. */
 
+	/** Packet waiting in the inbox of the agent. */
+	struct IncomingPacket
+	{
+		TCPSocketPtr socket;
+		PacketHeader packetHeader;
+		std::vector<char> data; /**< Packet body (after the header). */
+	};
+
+	MpscQueue<IncomingPacket> _inbox; /**< Packets received but not handled yet. */
+
 
 public:
 
@@ -81,17 +116,21 @@ public:
 	Node *node() const { return _node; }
 
 	/** It returns the identifier of the agent (within the host) */
-	uint16_t id() const { return _id; }
+	AgentId id() const { return _id; }
 
 private:
 
 	Node *_node; /**< Parent Node/player of the agent. */
 
-	uint16_t _id; /**< Agent identifier. */
+	friend class ModuleAgentContainer; /**< It assigns the identifier. */
+
+	AgentId _id; /**< Agent identifier. */
 
 	int _state; /**< Current state of the agent. */
 
-	std::vector<TCPSocketPtr> _sockets; /**< Sockets used from this agent. */
+	uint32_t _stateSerial; /**< Incremented on each setState(). */
+
+	std::chrono::steady_clock::time_point _stateStart; /**< Time of the last setState(). */
 };
 
 using AgentPtr = std::shared_ptr<Agent>;
@@ -13,7 +13,7 @@ public:
 
 	std::string hostIP; /**< IP address where the agent is. */
 	uint16_t hostPort; /**< Listen port of this host. */
-	uint16_t agentId; /**< Identifier of the MCC agent within the host. */
+	AgentId agentId; /**< Identifier of the MCC agent within the host. */
 
 	void Read(InputMemoryStream &stream) {
 		stream.Read(hostIP);
@@ -21,7 +21,7 @@ public:
 		stream.Read(agentId);
 	}
 
-	void Write(OutputMemoryStream &stream) {
+	void Write(OutputMemoryStream &stream) const {
 		stream.Write(hostIP);
 		stream.Write(hostPort);
 		stream.Write(agentId);
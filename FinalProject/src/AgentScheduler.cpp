@@ -0,0 +1,145 @@
+#include "AgentScheduler.h"
+
+
+AgentScheduler::AgentScheduler() :
+	_task(nullptr),
+	_pendingTasks(0),
+	_generation(0),
+	_busyWorkers(0),
+	_exit(false)
+{
+	_queues.emplace_back(new WorkQueue);
+}
+
+AgentScheduler::~AgentScheduler()
+{
+	stop();
+}
+
+void AgentScheduler::start(int threadCount)
+{
+	stop();
+
+	_exit = false;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		_queues.emplace_back(new WorkQueue);
+	}
+	for (int i = 0; i < threadCount; ++i)
+	{
+		_workers.emplace_back(&AgentScheduler::workerLoop, this, (size_t)i + 1);
+	}
+}
+
+void AgentScheduler::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_exit = true;
+	}
+	_wakeUp.notify_all();
+
+	for (auto &worker : _workers) {
+		worker.join();
+	}
+	_workers.clear();
+	_queues.resize(1);
+}
+
+void AgentScheduler::run(size_t taskCount, const std::function<void(size_t)> &task)
+{
+	// Single-threaded mode
+	if (_workers.empty())
+	{
+		for (size_t i = 0; i < taskCount; ++i) {
+			task(i);
+		}
+		return;
+	}
+
+	// Deal the tasks among all the queues
+	_task = &task;
+	_pendingTasks = taskCount;
+	for (size_t i = 0; i < taskCount; ++i)
+	{
+		WorkQueue &queue = *_queues[i % _queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(i);
+	}
+
+	// Wake up the workers and help them
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_generation++;
+	}
+	_wakeUp.notify_all();
+
+	runTasks(0);
+
+	// Wait for the tasks still running in other threads
+	std::unique_lock<std::mutex> lock(_mutex);
+	_done.wait(lock, [this]() { return _pendingTasks == 0 && _busyWorkers == 0; });
+	_task = nullptr;
+}
+
+void AgentScheduler::runTasks(size_t queueIndex)
+{
+	size_t task;
+	while (popTask(queueIndex, task) || stealTask(queueIndex, task))
+	{
+		(*_task)(task);
+		_pendingTasks--;
+	}
+}
+
+bool AgentScheduler::popTask(size_t queueIndex, size_t &task)
+{
+	WorkQueue &queue = *_queues[queueIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty()) {
+		return false;
+	}
+	task = queue.tasks.back();
+	queue.tasks.pop_back();
+	return true;
+}
+
+bool AgentScheduler::stealTask(size_t queueIndex, size_t &task)
+{
+	for (size_t i = 1; i < _queues.size(); ++i)
+	{
+		WorkQueue &queue = *_queues[(queueIndex + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void AgentScheduler::workerLoop(size_t queueIndex)
+{
+	uint64_t generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wakeUp.wait(lock, [&]() { return _exit || _generation != generation; });
+			if (_exit) {
+				return;
+			}
+			generation = _generation;
+			_busyWorkers++;
+		}
+
+		runTasks(queueIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_busyWorkers--;
+		}
+		_done.notify_all();
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing scheduler used by the ModuleAgentContainer to update
+ * independent groups of agents in parallel. Each worker (and the calling
+ * thread) has its own queue of tasks, and takes tasks from the queues of
+ * the others when its own queue runs out.
+ */
+class AgentScheduler
+{
+public:
+
+	// Constructor and destructor
+	AgentScheduler();
+	~AgentScheduler();
+
+	// It starts the worker threads
+	// With 0 threads, tasks run in the calling thread in order (deterministic)
+	void start(int threadCount);
+
+	// It stops and joins the worker threads
+	void stop();
+
+	// Number of worker threads
+	int threadCount() const { return (int)_workers.size(); }
+
+	// It runs task(i) for each i in [0, taskCount) and waits for all of them
+	void run(size_t taskCount, const std::function<void(size_t)> &task);
+
+private:
+
+	/** Tasks of one thread (popped by the owner from the back, stolen from the front). */
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<size_t> tasks;
+	};
+
+	// It runs tasks until all the queues are empty
+	void runTasks(size_t queueIndex);
+
+	bool popTask(size_t queueIndex, size_t &task);
+	bool stealTask(size_t queueIndex, size_t &task);
+
+	void workerLoop(size_t queueIndex);
+
+	std::vector<std::thread> _workers; /**< Worker threads. */
+	std::vector<std::unique_ptr<WorkQueue>> _queues; /**< Queue 0 belongs to the calling thread. */
+
+	const std::function<void(size_t)> *_task; /**< Task of the current run() call. */
+	std::atomic<size_t> _pendingTasks; /**< Tasks of the current run() not finished yet. */
+
+	std::mutex _mutex; /**< Protects the members below. */
+	std::condition_variable _wakeUp; /**< Signals a new run() or stop(). */
+	std::condition_variable _done; /**< Signals workers that finished their run. */
+	uint64_t _generation; /**< Incremented on each run(). */
+	int _busyWorkers; /**< Workers running tasks. */
+	bool _exit; /**< Whether or not the workers should exit. */
+};
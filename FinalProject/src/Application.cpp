@@ -1,12 +1,19 @@
 #include "Application.h"
-#include "ModuleWindow.h"
-#include "ModuleTextures.h"
 #include "ModuleNetworkManager.h"
 #include "ModuleAgentContainer.h"
-#include "ModuleMainMenu.h"
 #include "ModuleNodeCluster.h"
 #include "ModuleYellowPages.h"
+#include "ModuleSimulationDriver.h"
+#include "ModuleMetrics.h"
+#include "Globals.h"
+
+// GUI modules (not compiled in the Headless configuration)
+#ifndef HEADLESS_BUILD
+#include "ModuleWindow.h"
+#include "ModuleTextures.h"
+#include "ModuleMainMenu.h"
 #include "ModuleLogView.h"
+#endif
 
 #define ADD_MODULE(ModuleClass, moduleAttribute) \
 	moduleAttribute = new ModuleClass(); \
@@ -16,6 +23,19 @@ static Application *g_Instance = nullptr;
 
 Application::Application()
 {
+	// Headless runs only need the simulation modules
+	if (g_Config.headless)
+	{
+		ADD_MODULE(ModuleNetworkManager, networkManager);
+		ADD_MODULE(ModuleAgentContainer, agentContainer);
+		ADD_MODULE(ModuleNodeCluster, modNodeCluster);
+		ADD_MODULE(ModuleYellowPages, modYellowPages);
+		ADD_MODULE(ModuleSimulationDriver, modSimulationDriver);
+		ADD_MODULE(ModuleMetrics, modMetrics);
+		return;
+	}
+
+#ifndef HEADLESS_BUILD
 	// Create modules
 	ADD_MODULE(ModuleWindow, modWindow);
 	ADD_MODULE(ModuleLogView, modLogView);
@@ -25,6 +45,8 @@ Application::Application()
 	ADD_MODULE(ModuleMainMenu, modMainMenu);
 	ADD_MODULE(ModuleNodeCluster, modNodeCluster);
 	ADD_MODULE(ModuleYellowPages, modYellowPages);
+	ADD_MODULE(ModuleMetrics, modMetrics);
+#endif
 }
 
 
@@ -45,11 +67,22 @@ bool Application::init()
 	}
 
 	// Set active modules (calls start() on them)
+	if (g_Config.headless)
+	{
+		networkManager->setEnabled(true);
+		modSimulationDriver->setEnabled(true);
+		modMetrics->setEnabled(true);
+		return true;
+	}
+
+#ifndef HEADLESS_BUILD
 	modWindow->setEnabled(true);
 	modTextures->setEnabled(true);
 	networkManager->setEnabled(true);
 	modMainMenu->setEnabled(true);
 	modLogView->setEnabled(true);
+	modMetrics->setEnabled(true);
+#endif
 
 	return true;
 }
@@ -60,7 +93,7 @@ bool Application::update()
 
 	if (doUpdate() == false) return false;
 
-	if (doUpdateGUI() == false) return false;
+	if (!g_Config.headless && doUpdateGUI() == false) return false;
 
 	if (doPostUpdate() == false) return false;
 
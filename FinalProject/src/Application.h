@@ -12,6 +12,8 @@ class ModuleLogView;
 class ModuleMainMenu;
 class ModuleNodeCluster;
 class ModuleYellowPages;
+class ModuleSimulationDriver;
+class ModuleMetrics;
 
 class Application
 {
@@ -73,6 +75,8 @@ public:
 	ModuleMainMenu *modMainMenu = nullptr;
 	ModuleNodeCluster *modNodeCluster = nullptr;
 	ModuleYellowPages *modYellowPages = nullptr;
+	ModuleSimulationDriver *modSimulationDriver = nullptr;
+	ModuleMetrics *modMetrics = nullptr;
 
 
 private:
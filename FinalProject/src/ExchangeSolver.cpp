@@ -0,0 +1,172 @@
+#include "ExchangeSolver.h"
+#include "Node.h"
+#include <algorithm>
+#include <unordered_set>
+
+
+void ExchangeSolver::solve(const std::vector<Offer> &offers, size_t maxLength, std::vector<Cycle> &cycles)
+{
+	_offers = &offers;
+	_offersByItems.clear();
+	_wantedItems.clear();
+	_used.assign(offers.size(), false);
+	_itemChanges.clear();
+
+	// Only the items with offers are part of the graph
+	for (size_t i = 0; i < offers.size(); ++i)
+	{
+		const Offer &offer = offers[i];
+		if (offer.contributedItemId == offer.wantedItemId) {
+			continue;
+		}
+		std::vector<size_t> &bucket = _offersByItems[pairKey(offer.contributedItemId, offer.wantedItemId)];
+		if (bucket.empty()) {
+			_wantedItems[offer.contributedItemId].push_back(offer.wantedItemId);
+		}
+		bucket.push_back(i);
+	}
+
+	// Offers with the same items only differ by their nodes, so after a
+	// failed search the rest of them are skipped, unless the node of the
+	// failed one blocked the search (see extendCycle())
+	std::unordered_set<uint32_t> failed;
+
+	for (size_t start = 0; start < offers.size(); ++start)
+	{
+		const Offer &offer = offers[start];
+		if (offer.contributedItemId == offer.wantedItemId) {
+			continue;
+		}
+		const uint32_t startKey = pairKey(offer.contributedItemId, offer.wantedItemId);
+		if (failed.count(startKey) != 0) {
+			continue;
+		}
+
+		_path.clear();
+		_pathConflicts.clear();
+		if (!isAvailable(start)) {
+			continue;
+		}
+		_path.push_back(start);
+		_pathConflicts.push_back(false);
+		_pathItems.assign(1, offer.wantedItemId);
+
+		if (!extendCycle(offer.wantedItemId, offer.contributedItemId, maxLength))
+		{
+			if (!_pathConflicts.front()) {
+				failed.insert(startKey);
+			}
+			continue;
+		}
+
+		// Commit the exchange, so the next cycles see the new items
+		for (auto offerIndex : _path)
+		{
+			const Offer &member = offers[offerIndex];
+			changeItemCount(member.node, member.contributedItemId, -1);
+			changeItemCount(member.node, member.wantedItemId, +1);
+			_used[offerIndex] = true;
+		}
+		cycles.push_back(_path);
+	}
+
+	_offers = nullptr;
+}
+
+bool ExchangeSolver::extendCycle(uint16_t itemId, uint16_t closingItemId, size_t maxLength)
+{
+	if (_path.size() >= maxLength) {
+		return false;
+	}
+
+	auto edges = _wantedItems.find(itemId);
+	if (edges == _wantedItems.end()) {
+		return false;
+	}
+
+	for (auto wantedItemId : edges->second)
+	{
+		// Paths are short, so a linear search is enough
+		const bool closes = (wantedItemId == closingItemId);
+		if (!closes && (_path.size() + 1 >= maxLength ||
+			std::find(_pathItems.begin(), _pathItems.end(), wantedItemId) != _pathItems.end())) {
+			continue;
+		}
+
+		for (auto offerIndex : _offersByItems[pairKey(itemId, wantedItemId)])
+		{
+			if (!isAvailable(offerIndex)) {
+				continue;
+			}
+
+			_path.push_back(offerIndex);
+			_pathConflicts.push_back(false);
+			if (closes) {
+				return true;
+			}
+
+			_pathItems.push_back(wantedItemId);
+			if (extendCycle(wantedItemId, closingItemId, maxLength)) {
+				return true;
+			}
+			const bool blockedByNode = _pathConflicts.back();
+			_pathItems.pop_back();
+			_pathConflicts.pop_back();
+			_path.pop_back();
+
+			// The rest of offers of this pair of items only differ by their
+			// nodes, so they can only succeed if this node blocked the search
+			if (!blockedByNode) {
+				break;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool ExchangeSolver::isAvailable(size_t offerIndex)
+{
+	if (_used[offerIndex]) {
+		return false;
+	}
+
+	// The node must still have a spare unit of its item and miss the wanted one
+	const Offer &offer = (*_offers)[offerIndex];
+	if (itemCount(offer.node, offer.contributedItemId) < 2 || itemCount(offer.node, offer.wantedItemId) > 0) {
+		return false;
+	}
+
+	// A node takes part only once in each exchange
+	for (size_t position = 0; position < _path.size(); ++position) {
+		if ((*_offers)[_path[position]].node == offer.node) {
+			_pathConflicts[position] = true;
+			return false;
+		}
+	}
+	return true;
+}
+
+int ExchangeSolver::itemCount(Node *node, uint16_t itemId)
+{
+	if (itemId >= node->itemList().presentItems().size()) {
+		return 0;
+	}
+
+	int count = (int)node->itemList().numItemsWithId(itemId);
+
+	auto nodeIt = _itemChanges.find(node);
+	if (nodeIt != _itemChanges.end())
+	{
+		auto itemIt = nodeIt->second.find(itemId);
+		if (itemIt != nodeIt->second.end()) {
+			count += itemIt->second;
+		}
+	}
+	return count;
+}
+
+void ExchangeSolver::changeItemCount(Node *node, uint16_t itemId, int delta)
+{
+	_itemChanges[node][itemId] += delta;
+}
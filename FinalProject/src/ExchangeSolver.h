@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Globals.h"
+#include <unordered_map>
+#include <vector>
+
+class Agent;
+class Node;
+
+/**
+ * Centralized alternative to the MCP->UCP->MCP search. It takes the
+ * offers of the agents (an item given in exchange for another one)
+ * and looks directly for exchange cycles in the item graph, where
+ * each offer is an edge from its contributed item to its wanted item.
+ */
+class ExchangeSolver
+{
+public:
+
+	/** Agent willing to give an item of its node in exchange for another one. */
+	struct Offer
+	{
+		Agent *agent;
+		Node *node;
+		uint16_t contributedItemId;
+		uint16_t wantedItemId;
+	};
+
+	/** Indices of the offers of an exchange (each one gets the item of the next one). */
+	using Cycle = std::vector<size_t>;
+
+	// It finds disjoint cycles of up to maxLength offers, each one from a
+	// different node (earlier offers have priority to start a cycle)
+	void solve(const std::vector<Offer> &offers, size_t maxLength, std::vector<Cycle> &cycles);
+
+private:
+
+	// It looks for an offer giving itemId that leads back to closingItemId
+	bool extendCycle(uint16_t itemId, uint16_t closingItemId, size_t maxLength);
+
+	// Whether the offer can join the current path
+	// (offers rejected for a node already in the path mark that node in _pathConflicts)
+	bool isAvailable(size_t offerIndex);
+
+	// Items of the node, updated with the exchanges found so far
+	int itemCount(Node *node, uint16_t itemId);
+	void changeItemCount(Node *node, uint16_t itemId, int delta);
+
+	static uint32_t pairKey(uint16_t contributedItemId, uint16_t wantedItemId) { return ((uint32_t)contributedItemId << 16) | wantedItemId; }
+
+	const std::vector<Offer> *_offers = nullptr; /**< Offers being solved. */
+	std::unordered_map<uint32_t, std::vector<size_t>> _offersByItems; /**< Offers by (contributed, wanted) item. */
+	std::unordered_map<uint16_t, std::vector<uint16_t>> _wantedItems; /**< Items wanted in exchange for each item (the edges of the graph). */
+	std::vector<bool> _used; /**< Offers already in a cycle. */
+	std::unordered_map<Node*, std::unordered_map<uint16_t, int>> _itemChanges; /**< Items given/received by each node in the cycles found. */
+
+	Cycle _path; /**< Cycle being built. */
+	std::vector<uint16_t> _pathItems; /**< Items wanted along the path. */
+	std::vector<bool> _pathConflicts; /**< Whether the node of each offer of the path blocked another offer. */
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <cinttypes>
+#include <string>
 
 // Constants ///////////////////////////////////////////////////////////
 
@@ -12,6 +13,111 @@ static const uint16_t LISTEN_PORT_YP = 8000;
 /** Listen port used by the multi-agent application. */
 static const uint16_t LISTEN_PORT_AGENTS = 8001;
 
+/**
+ * Default number of partitions of the YellowPages. Each item is
+ * stored by the partition (itemId % partitions), so each
+ * YellowPages process only handles part of the items.
+ * See SimulationConfig::ypPartitions (option --yp-cluster).
+ */
+static const int DEFAULT_YP_PARTITIONS = 1;
+
+/**
+ * Default number of replicas of each YellowPages partition. MCC
+ * registrations are sent to all of them, and queries to the
+ * first replica that is reachable.
+ * See SimulationConfig::ypReplicas (option --yp-cluster).
+ */
+static const int DEFAULT_YP_REPLICAS = 1;
+
+/**
+ * First listen port of the YellowPages processes when there are
+ * several of them (see yellowPagesPort() in YellowPagesCluster.h).
+ * With a single process, LISTEN_PORT_YP is used instead.
+ */
+static const uint16_t LISTEN_PORT_YP_CLUSTER = 8100;
+
+/**
+ * Milliseconds a YellowPages replica that could not be connected
+ * is skipped by the queries before trying to connect it again.
+ */
+static const unsigned int YP_REPLICA_RETRY_MILLIS = 5000;
+
+/**
+ * Milliseconds a pooled connection can remain unused
+ * before being closed by the ModuleNetworkManager.
+ * Connections holding YellowPages subscriptions are pinned
+ * and never closed for being idle (see MCCDirectory).
+ */
+static const unsigned int POOL_IDLE_TIMEOUT_MILLIS = 30000;
+
+/**
+ * Milliseconds given to outgoing connections to complete
+ * before they are considered failed.
+ */
+static const unsigned int CONNECT_TIMEOUT_MILLIS = 5000;
+
+/**
+ * Maximum size in bytes of a single packet received from
+ * another process (e.g. YellowPages responses with many
+ * MCC locations). Bigger packets close the connection.
+ */
+static const uint32_t MAX_PACKET_SIZE = 4 * 1024 * 1024;
+
+/**
+ * Number of threads handling the socket I/O of the
+ * ModuleNetworkManager. With 0, sockets are handled by the
+ * main thread once per frame. Otherwise sockets are sharded
+ * across the threads and their packets are dispatched to the
+ * agents from the main thread.
+ */
+static const int NETWORK_IO_THREADS = 0;
+
+/**
+ * Whether packets between agents of the same process skip the
+ * sockets. They are queued in memory by the ModuleNetworkManager
+ * and delivered as if they came from a connection to localhost.
+ */
+static const bool ENABLE_LOOPBACK_TRANSPORT = true;
+
+/**
+ * Number of worker threads updating the agents of different
+ * nodes in parallel. With 0, agents are updated in order by
+ * the main thread (deterministic, useful for debugging).
+ */
+static const int AGENT_UPDATE_THREADS = 0;
+
+/**
+ * Number of MCCs a MCP asks for a negotiation at the same time.
+ * The first one accepting is used, and the rest are released.
+ * With 1, MCCs are asked one after another.
+ */
+static const unsigned int MCP_NEGOTIATION_FANOUT = 4;
+
+/**
+ * Milliseconds a MCP waits for the answer of a MCC before
+ * considering that the negotiation was rejected.
+ */
+static const unsigned int NEGOTIATION_TIMEOUT_MILLIS = 3000;
+
+/**
+ * Milliseconds agents wait for an answer of the YellowPages
+ * (MCC registration, MCP query) before retrying or giving up.
+ */
+static const unsigned int YP_REQUEST_TIMEOUT_MILLIS = 5000;
+
+/**
+ * Milliseconds the result of a sub-search (the child MCP of a UCP)
+ * is remembered. Meanwhile, UCPs needing the same search at the same
+ * or a deeper level answer that it failed without searching again.
+ */
+static const unsigned int SEARCH_CACHE_TTL_MILLIS = 2000;
+
+/**
+ * Milliseconds between dumps of the metrics in headless runs
+ * (see ModuleMetrics).
+ */
+static const unsigned int METRICS_DUMP_INTERVAL_MILLIS = 10000;
+
 /**
  * Constant used to specify that a message was sent to,
  * or received from no agent. This is the case when
@@ -19,7 +125,28 @@ static const uint16_t LISTEN_PORT_AGENTS = 8001;
  * a global service that contains information about
  * contributor agents, but uses no agents to work.
  */
-static const uint16_t NULL_AGENT_ID = 0;
+static const uint32_t NULL_AGENT_ID = 0;
+
+/**
+ * Agent identifiers combine the slot of the agent in the
+ * ModuleAgentContainer (low 16 bits) and the generation of
+ * that slot (high 16 bits, never 0), so identifiers of
+ * destroyed agents are not confused with new agents.
+ */
+using AgentId = uint32_t;
+
+/**
+ * Agents that can be alive at the same time in a process (one per
+ * slot, and slots have 16 bits). Beyond it, agents are not created.
+ */
+static const unsigned int MAX_AGENTS = 0x10000;
+
+/**
+ * Most MCCs spawned for a node by ModuleNodeCluster::spawnMCCs().
+ * With tens of thousands of items, every spare unit times every
+ * missing item would exceed MAX_AGENTS with a few nodes.
+ */
+static const unsigned int MAX_SPAWNED_MCCS_PER_NODE = 32;
 
 /*
  * RANDOM INITIALIZATION:
@@ -29,32 +156,92 @@ static const uint16_t NULL_AGENT_ID = 0;
 #define RANDOM_INITIALIZATION
 
 /**
- * MAX_ITEMS:
- * This constant defines which is the maximum number of items of the catalogue.
- * Items will be identified by an index between 0 and MAX_ITEMS - 1.
- *
- * MAX_NODES:
- * This constant defines which is the maximum number of items of the catalogue.
- * Items will be identified by an index between 0 and MAX_ITEMS - 1.
+ * Default size of the simulation (see SimulationConfig).
  */
 
 #if defined(RANDOM_INITIALIZATION)
 
-static const unsigned int MAX_ITEMS = 10U;
-static const unsigned int MAX_NODES = 10U;
+static const unsigned int DEFAULT_MAX_ITEMS = 10U;
+static const unsigned int DEFAULT_MAX_NODES = 10U;
 
 #else
 
-static const unsigned int MAX_ITEMS = 4U;
-static const unsigned int MAX_NODES = 4U;
+static const unsigned int DEFAULT_MAX_ITEMS = 4U;
+static const unsigned int DEFAULT_MAX_NODES = 4U;
 
 #endif
 
+static const unsigned int DEFAULT_MAX_SEARCH_DEPTH = 4U;
+
+/**
+ * Biggest catalogue supported (item ids travel as uint16_t).
+ */
+static const unsigned int MAX_CATALOGUE_ITEMS = 65535U;
+
 /**
- * MAX_SEARCH_DEPTH
+ * Size of the simulation, set before starting the node cluster
+ * (command line arguments --items, --nodes and --depth, or the
+ * main menu). It must be the same in every node cluster process.
+ *
+ * maxItems:
+ * Maximum number of items of the catalogue.
+ * Items will be identified by an index between 0 and maxItems - 1.
+ *
+ * maxNodes:
+ * Number of nodes spawned by the node cluster.
+ *
+ * maxSearchDepth:
  * This the maximum depth of the search performed by MCP/UCP agents.
- * If MAX_SEARCH_DEPTH == 0, only bilateral exchanges will be found.
- * If MAX_SEARCH_DEPTH == 1, trilateral exchanges will be also found.
+ * If maxSearchDepth == 0, only bilateral exchanges will be found.
+ * If maxSearchDepth == 1, trilateral exchanges will be also found.
  * etc.
+ *
+ * randomSeed:
+ * Seed of the random initialization of the nodes and of the agents
+ * spawned by the headless driver (0 to use a different one each run).
+ *
+ * ypPartitions, ypReplicas:
+ * Size of the YellowPages cluster (option --yp-cluster <partitions>
+ * <replicas>). It must be the same in every process, including the
+ * YellowPages ones.
+ *
+ * The rest of options are for headless runs (see ModuleSimulationDriver).
+ */
+struct SimulationConfig
+{
+	unsigned int maxItems = DEFAULT_MAX_ITEMS;
+	unsigned int maxNodes = DEFAULT_MAX_NODES;
+	unsigned int maxSearchDepth = DEFAULT_MAX_SEARCH_DEPTH;
+	unsigned int randomSeed = 0;
+	int ypPartitions = DEFAULT_YP_PARTITIONS;
+	int ypReplicas = DEFAULT_YP_REPLICAS;
+
+	bool headless = false; /**< Run without window nor GUI. */
+	bool headlessYellowPages = false; /**< Run a YellowPages process instead of a node cluster. */
+	int ypPartition = 0; /**< YellowPages partition to run. */
+	int ypReplica = 0; /**< YellowPages replica to run. */
+	std::string scriptPath; /**< Agents to spawn (none to spawn all the MCCs at once). */
+	unsigned int frames = 0; /**< Frames to run (0 to run until the script quits). */
+	std::string logPath; /**< File where the log is written. */
+	std::string benchmarkReportPath; /**< File where a line with the metrics of the run is appended. */
+	std::string metricsPath; /**< File where the periodic dumps of the metrics are appended (JSON lines). */
+};
+
+extern SimulationConfig g_Config;
+
+/**
+ * Milliseconds an agent at the given search depth can remain in a
+ * negotiation state waiting for its peer (UCC/UCP packets, MCC
+ * negotiating) before giving up. The agent waits for the sub-searches
+ * below it, so the deadline grows with the levels that remain:
+ *
+ *     (maxSearchDepth - depth + 1) * NEGOTIATION_TIMEOUT_MILLIS
+ *
+ * The UCC/UCP pair of a MCP at depth d is at depth d + 1, so each
+ * agent gives up one step before the agent waiting for it.
  */
-#define MAX_SEARCH_DEPTH 4
+inline unsigned int negotiationStateTimeoutMillis(unsigned int searchDepth)
+{
+	const unsigned int remainingLevels = searchDepth < g_Config.maxSearchDepth ? g_Config.maxSearchDepth - searchDepth : 0;
+	return (remainingLevels + 1) * NEGOTIATION_TIMEOUT_MILLIS;
+}
@@ -4,7 +4,63 @@
 #include <algorithm>
 
 
-ItemList::ItemList()
+void ItemSet::setAll()
+{
+	for (auto &word : _words) {
+		word = ~uint64_t(0);
+	}
+	clearUnusedBits();
+}
+
+void ItemSet::resetAll()
+{
+	for (auto &word : _words) {
+		word = 0;
+	}
+}
+
+size_t ItemSet::count() const
+{
+	size_t count = 0;
+	for (auto word : _words) {
+		count += std::bitset<64>(word).count();
+	}
+	return count;
+}
+
+bool ItemSet::none() const
+{
+	for (auto word : _words) {
+		if (word != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+ItemSet ItemSet::operator~() const
+{
+	ItemSet complement(_size);
+	for (size_t w = 0; w < _words.size(); ++w) {
+		complement._words[w] = ~_words[w];
+	}
+	complement.clearUnusedBits();
+	return complement;
+}
+
+void ItemSet::clearUnusedBits()
+{
+	if (_size % 64 != 0) {
+		_words.back() &= (uint64_t(1) << (_size % 64)) - 1;
+	}
+}
+
+
+ItemList::ItemList(unsigned int itemCount) :
+	items(itemCount, 0),
+	presentSet(itemCount),
+	spareSet(itemCount),
+	numberOfMissingItems(itemCount)
 {
 }
 
@@ -15,34 +71,50 @@ ItemList::~ItemList()
 
 void ItemList::initializeComplete()
 {
-	for (ItemId itemId = 0; itemId < MAX_ITEMS; ++itemId)
-	{
-		items[itemId] = 1;
-	}
-	numberOfItems = MAX_ITEMS;
+	std::fill(items.begin(), items.end(), 1);
+	presentSet.setAll();
+	spareSet.resetAll();
+	numberOfItems = (unsigned int)items.size();
 	numberOfMissingItems = 0;
 }
 
 void ItemList::addItem(ItemId itemId)
 {
-	assert(itemId < MAX_ITEMS && "ItemsList::addItem() - itemId out of bounds.");
-	items[itemId]++;
+	assert(itemId < items.size() && "ItemsList::addItem() - itemId out of bounds.");
+	assert(items[itemId] < UINT16_MAX && "ItemsList::addItem() - too many units of this item.");
+	const unsigned int count = ++items[itemId];
 	numberOfItems++;
-	recomputeMissingItems();
+
+	// Only the transitions 0->1 and 1->2 change the sets
+	if (count == 1) {
+		presentSet.set(itemId);
+		numberOfMissingItems--;
+	}
+	else if (count == 2) {
+		spareSet.set(itemId);
+	}
 }
 
 void ItemList::removeItem(ItemId itemId)
 {
-	assert(itemId < MAX_ITEMS && "ItemsList::removeItem() - itemId out of bounds.");
+	assert(itemId < items.size() && "ItemsList::removeItem() - itemId out of bounds.");
 	assert(items[itemId] > 0 && "ItemsList::removeItem() - the list does not contain this item.");
-	items[itemId]--;
+	const unsigned int count = --items[itemId];
 	numberOfItems--;
-	recomputeMissingItems();
+
+	// Only the transitions 1->0 and 2->1 change the sets
+	if (count == 0) {
+		presentSet.reset(itemId);
+		numberOfMissingItems++;
+	}
+	else if (count == 1) {
+		spareSet.reset(itemId);
+	}
 }
 
-unsigned int ItemList::numItemsWithId(ItemId itemId)
+unsigned int ItemList::numItemsWithId(ItemId itemId) const
 {
-	assert(itemId < MAX_ITEMS && "ItemsList::numItemsWithId() - itemId out of bounds.");
+	assert(itemId < items.size() && "ItemsList::numItemsWithId() - itemId out of bounds.");
 	return items[itemId];
 }
 
@@ -55,13 +127,3 @@ unsigned int ItemList::numMissingItems() const
 {
 	return numberOfMissingItems;
 }
-
-void ItemList::recomputeMissingItems()
-{
-	numberOfMissingItems = 0;
-	for (ItemId itemId = 0; itemId < MAX_ITEMS; ++itemId) {
-		if (items[itemId] == 0) {
-			numberOfMissingItems++;
-		}
-	}
-}
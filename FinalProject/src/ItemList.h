@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Globals.h"
+#include <bitset>
+#include <vector>
 
 /*
  * Type alias for item identifiers.
@@ -8,14 +10,73 @@
 using ItemId = unsigned int;
 
 /**
- * A list of items.
+ * Set of item identifiers (one bit per item of the catalogue). The
+ * bits are packed in 64-bit words, so bulk operations and iterations
+ * over sparse sets visit words instead of items.
+ */
+class ItemSet
+{
+public:
+
+	explicit ItemSet(size_t size = 0) : _size(size), _words((size + 63) / 64, 0) { }
+
+	size_t size() const { return _size; }
+
+	bool test(ItemId itemId) const { return (_words[itemId / 64] >> (itemId % 64)) & 1; }
+	void set(ItemId itemId) { _words[itemId / 64] |= uint64_t(1) << (itemId % 64); }
+	void reset(ItemId itemId) { _words[itemId / 64] &= ~(uint64_t(1) << (itemId % 64)); }
+
+	// All the items in or out of the set
+	void setAll();
+	void resetAll();
+
+	// Number of items in the set
+	size_t count() const;
+	bool none() const;
+	bool any() const { return !none(); }
+
+	// Items out of the set
+	ItemSet operator~() const;
+
+	// It calls the function for each item in the set, in increasing order
+	template <class Function>
+	void forEach(Function function) const
+	{
+		for (size_t w = 0; w < _words.size(); ++w)
+		{
+			uint64_t word = _words[w];
+			while (word != 0)
+			{
+				// Index of the lowest bit set (counting the bits below it)
+				const uint64_t lowestBit = word & (~word + 1);
+				const size_t bit = std::bitset<64>(lowestBit - 1).count();
+				function(static_cast<ItemId>(w * 64 + bit));
+				word ^= lowestBit;
+			}
+		}
+	}
+
+private:
+
+	// Bits past _size are kept at zero
+	void clearUnusedBits();
+
+	size_t _size; /**< Number of items of the catalogue. */
+	std::vector<uint64_t> _words; /**< Bit i of word w is item w * 64 + i. */
+};
+
+/**
+ * A list of items. Besides the number of units of each item, it
+ * keeps which items are present and which are repeated (spare) as
+ * bitsets, so the missing and spare items of a node can be obtained
+ * with a few word operations even for large catalogues.
  */
 class ItemList
 {
 public:
 
-	// Constructor and destructor
-	ItemList();
+	// Constructor and destructor (items are identified from 0 to itemCount - 1)
+	explicit ItemList(unsigned int itemCount);
 	~ItemList();
 
 	// It initializes the list with all the items appearing exactly once
@@ -26,21 +87,24 @@ public:
 	void removeItem(ItemId itemId);
 
 	// It returns the number of items with the given Id
-	unsigned int numItemsWithId(ItemId itemId);
+	unsigned int numItemsWithId(ItemId itemId) const;
 
 	// Returns the total number of items in the list (counting repeated items)
 	unsigned int numItems() const;
 
-	// Returns the number of missing items (number of items from 0 to MAX_ITEMS -1 not in the list)
+	// Returns the number of missing items (number of items from 0 to itemCount - 1 not in the list)
 	unsigned int numMissingItems() const;
 
+	// Bulk queries
+	const ItemSet &presentItems() const { return presentSet; } // Items with at least one unit
+	const ItemSet &spareItems() const { return spareSet; }     // Items with at least two units
+	ItemSet missingItems() const { return ~presentSet; }       // Items without units
 
 private:
 
-	// Recomputes the number of missing items after adding or removing
-	void recomputeMissingItems();
-
-	int items[MAX_ITEMS] = {};
+	std::vector<uint16_t> items; /**< Units of each item. */
+	ItemSet presentSet; /**< Bit set if items[itemId] > 0. */
+	ItemSet spareSet; /**< Bit set if items[itemId] > 1. */
 	unsigned int numberOfItems = 0;
-	unsigned int numberOfMissingItems = MAX_ITEMS;
+	unsigned int numberOfMissingItems = 0;
 };
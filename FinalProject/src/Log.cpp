@@ -2,10 +2,11 @@
 
 #include "Log.h"
 #include <Windows.h>
-#include <iostream>
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
+#include <iostream>
 
 // Array of strings with the names of LogLevels
 static const char *s_LevelStrings[] = {
@@ -72,29 +73,29 @@ LogMessage& LogMessage::operator<<(const std::string& text)
 
 LogMessage& LogMessage::operator<<(int i)
 {
-	std::ostringstream ss; ss << i;
-	_buffer.append(ss.str());
+	appendInteger(i < 0 ? 0U - (unsigned int)i : (unsigned int)i, i < 0);
 	return *this;
 }
 
 LogMessage& LogMessage::operator<<(unsigned int i)
 {
-	std::ostringstream ss; ss << i;
-	_buffer.append(ss.str());
+	appendInteger(i, false);
 	return *this;
 }
 
 LogMessage& LogMessage::operator<<(float f)
 {
-	std::ostringstream ss; ss << f;
-	_buffer.append(ss.str());
-	return *this;
+	return *this << (double)f;
 }
 
 LogMessage& LogMessage::operator<<(double d)
 {
-	std::ostringstream ss; ss << d;
-	_buffer.append(ss.str());
+	// Same format as the default of std::ostream
+	char digits[32];
+	const int length = snprintf(digits, sizeof(digits), "%g", d);
+	if (length > 0) {
+		_buffer.append(digits, std::min((size_t)length, sizeof(digits) - 1));
+	}
 	return *this;
 }
 
@@ -104,16 +105,51 @@ LogMessage& LogMessage::operator<<(LogLevel l)
 	return *this;
 }
 
+void LogMessage::appendInteger(unsigned int value, bool negative)
+{
+	// Digits are written backwards from the end of the array
+	char digits[16];
+	char *first = digits + sizeof(digits);
+	do {
+		*--first = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+	if (negative) {
+		*--first = '-';
+	}
+	_buffer.append(first, digits + sizeof(digits));
+}
+
 
 // Log /////////////////////////////////////////////////////////////////
 
+// Time the logger thread sleeps without messages (pushes wake it up
+// earlier, this only bounds the delay of a wake-up that was missed)
+static const int IDLE_WAIT_MILLIS = 10;
+
 Log::Log() :
 	_cout(true),
-	_verbosity(LAll)
-{ }
+	_verbosity(LAll),
+	_running(true),
+	_sleeping(false)
+{
+	_thread = std::thread(&Log::run, this);
+}
 
 Log::~Log()
-{ }
+{
+	// The logger thread writes the queued messages before finishing
+	_running = false;
+	_wakeCondition.notify_one();
+	if (_thread.joinable()) {
+		_thread.join();
+	}
+
+	// A producer that saw _running before it changed can push after the
+	// last drain of the logger thread, so the queue is emptied once more
+	std::string line;
+	drain(line);
+}
 
 void Log::enableConsoleOutput(bool enable)
 {
@@ -122,17 +158,26 @@ void Log::enableConsoleOutput(bool enable)
 
 bool Log::enableFileOutput(const std::string& filepath)
 {
-	std::fstream file(filepath.c_str(), std::ios::out | std::ios::trunc);
-	bool is_open = file.is_open();
-	if (is_open) { _filename = filepath; }
-	return is_open;
+	std::lock_guard<std::mutex> lock(_outputMutex);
+
+	_file.close();
+	_file.clear();
+	_file.open(filepath.c_str(), std::ios::out | std::ios::trunc);
+	return _file.is_open();
 }
 
 void Log::addOutput(LogOutput *output)
 {
+	std::lock_guard<std::mutex> lock(_outputMutex);
 	_outputs.push_back(output);
 }
 
+void Log::removeOutput(LogOutput *output)
+{
+	std::lock_guard<std::mutex> lock(_outputMutex);
+	_outputs.erase(std::remove(_outputs.begin(), _outputs.end(), output), _outputs.end());
+}
+
 void Log::setVerbosity(LogLevel level)
 {
 	_verbosity = level;
@@ -148,39 +193,111 @@ LogMessage Log::operator()(const char *file, int line)
 	return LogMessage(this, file, line);
 }
 
-void Log::flush(const LogMessage &m)
+void Log::flush(LogMessage &m)
 {
-	const std::string &text(m.str());
-	if (_verbosity >= m.level())
+	if (_verbosity < m.level()) {
+		return;
+	}
+
+	Record record;
+	record.level = m.level();
+	record.hasSource = (m.file() != nullptr);
+	record.timestamp = record.hasSource ? (unsigned int)GetTickCount() : 0U;
+	record.text.swap(m._buffer);
+
+	// Without logger thread (static destruction), messages are written at once
+	if (!_running)
 	{
-		char wholeText[1024];
-		char fileLine[512];
-
-		const char *srcfile = m.file();
-		int srcline = m.line();
-		const char *lvlstr = s_LevelStrings[m.level()];
-		if (srcfile) {
-			sprintf(fileLine, "%s:%d", srcfile, srcline);
-			const int paddingCount = 7 - (int)strlen(lvlstr);
-			char padding[7] = { ' ',' ',' ',' ',' ',' ',' ' };
-			padding[paddingCount] = '\0';
-			//sprintf(wholeText, "<%s>%s | %s       (%s)\n", lvlstr, padding, text.c_str(), fileLine);
-			int timestamp = GetTickCount();
-			sprintf(wholeText, "%06d <%s>%s | %s\n", timestamp, lvlstr, padding, text.c_str());
+		std::lock_guard<std::mutex> lock(_outputMutex);
+		std::string line;
+		write(record, line);
+		_file.flush();
+		std::cout.flush();
+		return;
+	}
+
+	// If the queue is full, wait for the logger thread to free some slots
+	while (!_queue.TryPush(std::move(record))) {
+		_wakeCondition.notify_one();
+		std::this_thread::yield();
+	}
+
+	if (_sleeping.load(std::memory_order_relaxed)) {
+		_wakeCondition.notify_one();
+	}
+}
+
+void Log::run()
+{
+	std::string line;
+
+	for (;;)
+	{
+		// Messages pushed before stopping are still written
+		const bool running = _running;
+
+		const bool written = drain(line);
+
+		if (!running) {
+			break;
 		}
-		else {
-			sprintf(wholeText, "<%s> - %s\n", lvlstr, text.c_str());
+
+		if (!written)
+		{
+			std::unique_lock<std::mutex> lock(_wakeMutex);
+			_sleeping = true;
+			_wakeCondition.wait_for(lock, std::chrono::milliseconds(IDLE_WAIT_MILLIS));
+			_sleeping = false;
 		}
+	}
+}
+
+bool Log::drain(std::string &line)
+{
+	std::lock_guard<std::mutex> lock(_outputMutex);
+
+	Record record;
+	bool written = false;
+	while (_queue.TryPop(record)) {
+		write(record, line);
+		written = true;
+	}
 
-		if (!_filename.empty()) {
-			std::fstream file(_filename.c_str(), std::ios::out | std::ios::app);
-			file << wholeText << std::flush;
+	// Outputs are flushed once per block of messages
+	if (written) {
+		if (_file.is_open()) {
+			_file.flush();
 		}
 		if (_cout) {
-			std::cout << wholeText << std::flush;
-		}
-		for (auto output : _outputs) {
-			output->writeMessage(wholeText);
+			std::cout.flush();
 		}
 	}
+	return written;
+}
+
+void Log::write(const Record &record, std::string &line)
+{
+	const char *lvlstr = s_LevelStrings[record.level];
+
+	line.clear();
+	if (record.hasSource) {
+		char timestamp[16];
+		snprintf(timestamp, sizeof(timestamp), "%06u", record.timestamp);
+		const size_t paddingCount = 7 - strlen(lvlstr);
+		line.append(timestamp).append(" <").append(lvlstr).append(">").append(paddingCount, ' ').append(" | ");
+	}
+	else {
+		line.append("<").append(lvlstr).append("> - ");
+	}
+	line.append(record.text).append("\n");
+
+	if (_file.is_open()) {
+		_file << line;
+	}
+	if (_cout) {
+		std::cout << line;
+	}
+	for (auto output : _outputs) {
+		output->writeMessage(line);
+	}
 }
@@ -1,8 +1,14 @@
 #ifndef M_LOG_H
 #define M_LOG_H
 
+#include "net/MpscRingBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
+#include <mutex>
 
 
 #define eLog g_Log(__FILE__, __LINE__) << LError
@@ -35,7 +41,7 @@ public:
 	int line() const;
 	LogLevel level() const;
 
-	// Basic output operators
+	// Basic output operators (numbers are formatted without allocations)
 	LogMessage& operator<<(const std::string& text);
 	LogMessage& operator<<(int i);
 	LogMessage& operator<<(unsigned int i);
@@ -50,6 +56,9 @@ private:
 	LogMessage(Log *owner, const char *file, int line);
 	friend class Log;
 
+	// It appends the decimal digits of the number
+	void appendInteger(unsigned int value, bool negative);
+
 	// Private attributes
 	Log *_owner; /**< Log instance that created this message. */
 	std::string _buffer; /**< User defined log message. */
@@ -61,6 +70,7 @@ private:
 
 /***********************************************************************
 * LogOutput interface.
+* Messages are written from the logger thread.
 **********************************************************************/
 class LogOutput
 {
@@ -74,6 +84,9 @@ public:
 
 /***********************************************************************
 * Logging class.
+* Flushed messages are queued into a lock-free ring buffer, and a
+* logger thread formats them and writes them to the outputs, so the
+* threads logging never wait for the console or the file.
 **********************************************************************/
 class Log
 {
@@ -83,10 +96,39 @@ private:
 	// Private members
 	////////////////////////////////////////////////////////////////////
 
-	bool _cout; /**< Whether or not log to std::cout. */
-	std::string _filename; /**< Output file. */
+	/** Message waiting for the logger thread. */
+	struct Record
+	{
+		LogLevel level = LNone;
+		bool hasSource = false; /**< Whether it was logged with file and line (timestamped). */
+		unsigned int timestamp = 0;
+		std::string text;
+	};
+
+	static const size_t QUEUE_CAPACITY = 4096; /**< Messages queued at most (more wait for free slots). */
+
+	std::atomic<bool> _cout; /**< Whether or not log to std::cout. */
+	std::ofstream _file; /**< Output file (kept open, written in blocks). */
 	LogLevel _verbosity; /**< Log verbosity level. */
 	std::vector<LogOutput*> _outputs; /**< Array of LogOutput objects. */
+	std::mutex _outputMutex; /**< It protects the outputs from the logger thread. */
+
+	MpscRingBuffer<Record, QUEUE_CAPACITY> _queue; /**< Messages flushed but not written yet. */
+	std::atomic<bool> _running; /**< Whether the logger thread runs (otherwise messages are written at once). */
+	std::atomic<bool> _sleeping; /**< Whether the logger thread waits for messages. */
+	std::mutex _wakeMutex;
+	std::condition_variable _wakeCondition;
+	std::thread _thread; /**< Logger thread. */
+
+	// Logger thread loop
+	void run();
+
+	// It writes the queued messages and flushes the outputs,
+	// it returns whether there was any message
+	bool drain(std::string &line);
+
+	// It formats and writes the message to all the outputs (with _outputMutex locked)
+	void write(const Record &record, std::string &line);
 
 
 public:
@@ -124,6 +166,11 @@ public:
 	 */
 	void addOutput(LogOutput *output);
 
+	/**
+	 * It removes an extra output (it is not called anymore after this).
+	 */
+	void removeOutput(LogOutput *output);
+
 	/**
 	* It sets the verbosity for this Log.
 	* @param Level of verbosity.
@@ -149,10 +196,10 @@ public:
 	LogMessage operator()(const char *file, int line);
 
 	/**
-	* It flushes the message content onto the logging stream.
-	* @param m A log message that has already been filled.
+	* It queues the message content for the logging stream.
+	* @param m A log message that has already been filled (its text is moved).
 	*/
-	void flush(const LogMessage &m);
+	void flush(LogMessage &m);
 };
 
 
@@ -34,6 +34,7 @@ void MCC::update()
 	case ST_INIT:
 		if (registerIntoYellowPages()) {
 			setState(ST_REGISTERING);
+			setStateTimeout(YP_REQUEST_TIMEOUT_MILLIS);
 		}
 		else {
 			setState(ST_FINISHED);
@@ -47,10 +48,10 @@ void MCC::update()
 		// TODO: Handle other states
 	case ST_NEGOTIATIONS:
 		if (UCC != nullptr && UCC->NegotiationClosed() == true) {
-			if (negotiationAgreement()) {
-				setState(ST_FINISHED);																	////// SISMISMEISIAIE
-			}
-			destroyChildUCC();
+			// Without agreement, the MCC can negotiate with other MCPs
+			const bool agreement = UCC->NegotiationSuccess();
+			closeNegotiation();
+			setState(agreement ? ST_FINISHED : ST_IDLE);
 		}
 		break;
 	case ST_FINISHED:
@@ -78,10 +79,10 @@ void MCC::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 		if (state() == ST_REGISTERING)
 		{
 			setState(ST_IDLE);
-			socket->Disconnect();
 		}
-		else
+		else if (g_Config.ypReplicas == 1)
 		{
+			// (with replicas, every replica acknowledges the registration)
 			wLog << "OnPacketReceived() - PacketType::RegisterMCCAck was unexpected.";
 		}
 		break;
@@ -90,13 +91,25 @@ void MCC::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 		case PacketType::RequestForNegotiation:
 		if (state() == ST_IDLE) 
 		{
+			PacketNegotiationRequest packetBody;
+			packetBody.Read(stream);
+			_negotiationSearchDepth = packetBody._searchDepth;
+
 			AgentLocation uccLoc;
 			createChildUCC();
+			if (UCC == nullptr) {
+				// No agent could be created, the MCP will ask other MCCs
+				acceptNegotiation(socket, packetHeader.srcAgentId, false, uccLoc);
+				break;
+			}
 			uccLoc.agentId = UCC->id();
 			uccLoc.hostIP = socket->RemoteAddress().GetIPString();
 			uccLoc.hostPort = LISTEN_PORT_AGENTS;
 			acceptNegotiation(socket, packetHeader.srcAgentId, true, uccLoc);
+			_negotiationSocket = socket;
+			_negotiationAgentId = packetHeader.srcAgentId;
 			setState(ST_NEGOTIATIONS);
+			setStateTimeout(negotiationStateTimeoutMillis(_negotiationSearchDepth));
 		}
 		else
 		{
@@ -105,11 +118,43 @@ void MCC::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 			wLog << "MCC::OnPacketReceived() - PacketType::NegotiationRequest was unexpected.";
 		}
 		break;
+	case PacketType::ReleaseNegotiation:
+		// The MCP found another MCC first (or gave up waiting)
+		// Releases from MCPs this MCC rejected are ignored
+		if (state() == ST_NEGOTIATIONS && socket == _negotiationSocket && packetHeader.srcAgentId == _negotiationAgentId)
+		{
+			closeNegotiation();
+			setState(ST_IDLE);
+		}
+		break;
 	default:
 		wLog << "OnPacketReceived() - Unexpected PacketType.";
 	}
 }
 
+void MCC::OnTimeout()
+{
+	switch (state())
+	{
+	case ST_REGISTERING:
+		// The registration or its ack got lost (registering twice is harmless)
+		wLog << "MCC::Registration timed out, retrying";
+		registerIntoYellowPages();
+		setState(ST_REGISTERING);
+		setStateTimeout(YP_REQUEST_TIMEOUT_MILLIS);
+		break;
+
+	case ST_NEGOTIATIONS:
+		// The MCP or its UCP is gone (the UCC tells the UCP, if any)
+		wLog << "MCC::Negotiation timed out";
+		closeNegotiation();
+		setState(ST_IDLE);
+		break;
+
+	default:;
+	}
+}
+
 bool MCC::isIdling() const
 {
 	return state() == ST_IDLE;
@@ -120,6 +165,11 @@ bool MCC::negotiationFinished() const
 	return state() == ST_FINISHED;
 }
 
+void MCC::commitExchange()
+{
+	setState(ST_FINISHED);
+}
+
 bool MCC::negotiationAgreement() const
 {
 	// If this agent finished, means that it was an agreement
@@ -127,7 +177,7 @@ bool MCC::negotiationAgreement() const
 	return negotiationFinished();
 }
 
-bool MCC::acceptNegotiation(TCPSocketPtr socket, uint16_t dstID, bool accept, AgentLocation &uccLoc)
+bool MCC::acceptNegotiation(TCPSocketPtr socket, AgentId dstID, bool accept, AgentLocation &uccLoc)
 {
 	PacketHeader packetHead;
 	packetHead.packetType = PacketType::ReturnForNegotiation;
@@ -146,45 +196,21 @@ bool MCC::acceptNegotiation(TCPSocketPtr socket, uint16_t dstID, bool accept, Ag
 	iLog << "MCC::Sending Negotiation Response";
 	iLog << accept;
 
-	socket->SendPacket(stream.GetBufferPtr(), stream.GetSize());
+	sendPacketToSocket(socket, stream);
 
 	return false;
 }
 
 bool MCC::registerIntoYellowPages()
 {
-	// Create message header and data
-	PacketHeader packetHead;
-	packetHead.packetType = PacketType::RegisterMCC;
-	packetHead.srcAgentId = id();
-	packetHead.dstAgentId = -1;
-	PacketRegisterMCC packetData;
-	packetData.itemId = _contributedItemId;
-
-	// Serialize message
-	OutputMemoryStream stream;
-	packetHead.Write(stream);
-	packetData.Write(stream);
-
-	return sendPacketToYellowPages(stream);
+	// Registrations of the same frame are sent together (see MCCRegistrationBatcher)
+	App->agentContainer->mccRegistrations().registerMCC(id(), _contributedItemId);
+	return true;
 }
 
 void MCC::unregisterFromYellowPages()
 {
-	// Create message
-	PacketHeader packetHead;
-	packetHead.packetType = PacketType::UnregisterMCC;
-	packetHead.srcAgentId = id();
-	packetHead.dstAgentId = -1;
-	PacketUnregisterMCC packetData;
-	packetData.itemId = _contributedItemId;
-
-	// Serialize message
-	OutputMemoryStream stream;
-	packetHead.Write(stream);
-	packetData.Write(stream);
-
-	sendPacketToYellowPages(stream);
+	App->agentContainer->mccRegistrations().unregisterMCC(id(), _contributedItemId);
 }
 
 void MCC::createChildUCC()
@@ -193,8 +219,16 @@ void MCC::createChildUCC()
 	if (UCC != nullptr)
 		destroyChildUCC();
 	iLog << "UCC Child created";
-	UCC = App->agentContainer->createUCC(node(), contributedItemId(), constraintItemId());
+	// The UCC answers the UCP of the MCP, one level deeper
+	UCC = App->agentContainer->createUCC(node(), contributedItemId(), constraintItemId(), _negotiationSearchDepth + 1);
+
+}
 
+void MCC::closeNegotiation()
+{
+	destroyChildUCC();
+	_negotiationSocket = nullptr;
+	_negotiationAgentId = NULL_AGENT_ID;
 }
 
 void MCC::destroyChildUCC()
@@ -19,6 +19,7 @@ public:
 	void stop() override;
 	MCC* asMCC() override { return this; }
 	void OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader, InputMemoryStream &stream) override;
+	void OnTimeout() override;
 
 	// Getters
 	bool isIdling() const;
@@ -31,8 +32,12 @@ public:
 	// Whether or not there was a negotiation agreement
 	bool negotiationAgreement() const;
 
+	// It finishes the MCC as if it had negotiated an exchange
+	// (used by the centralized ExchangeSolver)
+	void commitExchange();
+
 	//Accept the negotiation
-	bool acceptNegotiation(TCPSocketPtr socket, uint16_t dstID, bool accept, AgentLocation &uccLoc);
+	bool acceptNegotiation(TCPSocketPtr socket, AgentId dstID, bool accept, AgentLocation &uccLoc);
 
 private:
 
@@ -44,8 +49,15 @@ private:
 
 	void destroyChildUCC();
 
+	// It destroys the UCC and forgets the MCP negotiating
+	void closeNegotiation();
+
 	uint16_t _contributedItemId; /**< The contributed item. */
 	uint16_t _constraintItemId; /**< The constraint item. */
 
 	UCCPtr UCC; /**< Child UCC. */
+
+	TCPSocketPtr _negotiationSocket; /**< Connection of the MCP negotiating with this MCC. */
+	AgentId _negotiationAgentId = NULL_AGENT_ID; /**< MCP negotiating with this MCC. */
+	unsigned int _negotiationSearchDepth = 0; /**< Search depth of the MCP negotiating with this MCC. */
 };
@@ -0,0 +1,189 @@
+#include "MCCDirectory.h"
+#include "ModuleNetworkManager.h"
+#include "Application.h"
+#include "YellowPagesCluster.h"
+#include "Log.h"
+#include <algorithm>
+
+
+bool MCCDirectory::getMCCsForItem(uint16_t itemId, std::vector<AgentLocation> &mccs)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto it = _items.find(itemId);
+	if (it == _items.end())
+	{
+		_items[itemId];
+		_pendingSubscriptions.push_back(itemId);
+		return false;
+	}
+	if (!it->second.ready)
+	{
+		return false;
+	}
+
+	mccs = it->second.mccs;
+	return true;
+}
+
+void MCCDirectory::sendSubscriptions()
+{
+	std::vector<uint16_t> itemIds;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		itemIds.swap(_pendingSubscriptions);
+	}
+	if (itemIds.empty()) {
+		return;
+	}
+
+	// Each item is subscribed in the YellowPages partition storing it
+	std::vector<std::vector<uint16_t>> itemIdsByPartition(g_Config.ypPartitions);
+	_sockets.resize(g_Config.ypPartitions);
+	for (auto itemId : itemIds) {
+		itemIdsByPartition[yellowPagesPartition(itemId)].push_back(itemId);
+	}
+
+	for (int partition = 0; partition < g_Config.ypPartitions; ++partition)
+	{
+		std::vector<uint16_t> &partitionItemIds = itemIdsByPartition[partition];
+		if (partitionItemIds.empty()) {
+			continue;
+		}
+
+		// Subscriptions use the pooled connection to a replica of the partition
+		TCPSocketPtr socket = App->networkManager->getYellowPagesConnection(partitionItemIds.front());
+		if (socket == nullptr)
+		{
+			// They will be requested again
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto itemId : partitionItemIds) {
+				_items.erase(itemId);
+			}
+			continue;
+		}
+		if (_sockets[partition] != nullptr && _sockets[partition] != socket)
+		{
+			// The previous connection was closed (or another replica is used now),
+			// so subscribe again to everything in this partition
+			std::lock_guard<std::mutex> lock(_mutex);
+			partitionItemIds.clear();
+			for (auto &item : _items) {
+				if (yellowPagesPartition(item.first) == partition) {
+					item.second.ready = false;
+					item.second.mccs.clear();
+					partitionItemIds.push_back(item.first);
+				}
+			}
+		}
+		_sockets[partition] = socket;
+
+		// The subscriptions last while the connection is open, even without traffic
+		App->networkManager->setConnectionPinned(socket, true);
+
+		for (auto itemId : partitionItemIds)
+		{
+			PacketHeader packetHead;
+			packetHead.packetType = PacketType::SubscribeMCCsForItem;
+			PacketSubscribeMCCsForItem packetData;
+			packetData.itemId = itemId;
+
+			OutputMemoryStream stream;
+			packetHead.Write(stream);
+			packetData.Write(stream);
+			App->networkManager->sendPacket(socket, stream);
+		}
+	}
+}
+
+bool MCCDirectory::handlePacket(TCPSocketPtr socket, const PacketHeader &packetHeader, InputMemoryStream &stream)
+{
+	switch (packetHeader.packetType)
+	{
+	case PacketType::SnapshotMCCsForItem:
+	{
+		PacketSnapshotMCCsForItem packetData;
+		packetData.Read(stream);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		ItemView &item = _items[packetData.itemId];
+		item.mccs.swap(packetData.mccs.mccAddresses);
+		item.ready = true;
+		return true;
+	}
+	case PacketType::MCCRegistered:
+	case PacketType::MCCUnregistered:
+	{
+		PacketMCCDelta packetData;
+		packetData.Read(stream);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _items.find(packetData.itemId);
+		if (it == _items.end() || !it->second.ready) {
+			return true; // Not subscribed (or the snapshot is still on the way)
+		}
+
+		std::vector<AgentLocation> &mccs = it->second.mccs;
+		auto mccIt = std::find_if(mccs.begin(), mccs.end(), [&](const AgentLocation &mcc) {
+			return mcc.agentId == packetData.mcc.agentId && mcc.hostIP == packetData.mcc.hostIP && mcc.hostPort == packetData.mcc.hostPort;
+		});
+		if (packetHeader.packetType == PacketType::MCCRegistered)
+		{
+			// The snapshot can already include it
+			if (mccIt == mccs.end()) {
+				mccs.push_back(packetData.mcc);
+			}
+		}
+		else if (mccIt != mccs.end())
+		{
+			mccs.erase(mccIt);
+		}
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+void MCCDirectory::handleDisconnection(TCPSocketPtr socket)
+{
+	for (int partition = 0; partition < (int)_sockets.size(); ++partition)
+	{
+		if (socket != _sockets[partition]) {
+			continue;
+		}
+
+		iLog << "YellowPages subscriptions lost (partition " << partition << ")";
+
+		// They will be requested again by the MCPs
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto it = _items.begin(); it != _items.end(); )
+		{
+			if (yellowPagesPartition(it->first) == partition) {
+				it = _items.erase(it);
+			} else {
+				++it;
+			}
+		}
+		_sockets[partition] = nullptr;
+	}
+}
+
+size_t MCCDirectory::subscribedItemsCount()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _items.size();
+}
+
+void MCCDirectory::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_items.clear();
+	_pendingSubscriptions.clear();
+	for (auto &socket : _sockets) {
+		if (socket != nullptr) {
+			App->networkManager->setConnectionPinned(socket, false);
+		}
+		socket = nullptr;
+	}
+}
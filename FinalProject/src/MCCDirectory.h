@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Globals.h"
+#include "Packets.h"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Local copy of the YellowPages kept by a node cluster. Items are
+ * subscribed the first time a MCP looks for them, and from then on
+ * the YellowPages pushes their changes, so later searches for the
+ * same item start without querying the YellowPages.
+ */
+class MCCDirectory
+{
+public:
+
+	// It copies the MCCs of the item if they are known locally
+	// Otherwise it returns false and the item will be subscribed
+	// (it can be called from several threads)
+	bool getMCCsForItem(uint16_t itemId, std::vector<AgentLocation> &mccs);
+
+	// It sends the subscriptions requested since the last call
+	void sendSubscriptions();
+
+	// It handles the subscription packets sent by the YellowPages
+	// (it returns false for other packets)
+	bool handlePacket(TCPSocketPtr socket, const PacketHeader &packetHeader, InputMemoryStream &stream);
+
+	// Subscriptions of a partition are lost when its YellowPages connection closes
+	void handleDisconnection(TCPSocketPtr socket);
+
+	// Number of subscribed items
+	size_t subscribedItemsCount();
+
+	void clear();
+
+private:
+
+	/** Local copy of the MCCs of a subscribed item. */
+	struct ItemView
+	{
+		bool ready = false; /**< Whether or not the snapshot was received. */
+		std::vector<AgentLocation> mccs;
+	};
+
+	std::mutex _mutex; /**< MCPs can be updated from several threads. */
+	std::unordered_map<uint16_t, ItemView> _items; /**< Subscribed items. */
+	std::vector<uint16_t> _pendingSubscriptions; /**< Items to subscribe to. */
+	std::vector<TCPSocketPtr> _sockets; /**< Connection with the subscriptions of each YellowPages partition. */
+};
@@ -0,0 +1,70 @@
+#include "MCCRegistrationBatcher.h"
+#include "ModuleNetworkManager.h"
+#include "Application.h"
+#include "YellowPagesCluster.h"
+#include "Log.h"
+
+
+void MCCRegistrationBatcher::registerMCC(AgentId agentId, uint16_t itemId)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_registrations.push_back({ agentId, itemId });
+}
+
+void MCCRegistrationBatcher::unregisterMCC(AgentId agentId, uint16_t itemId)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_unregistrations.push_back({ agentId, itemId });
+}
+
+void MCCRegistrationBatcher::flush()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_flushedRegistrations.swap(_registrations);
+		_flushedUnregistrations.swap(_unregistrations);
+	}
+
+	// Registrations go first, in case a MCC was unregistered in the same frame
+	sendBatches(PacketType::RegisterMCCBatch, _flushedRegistrations);
+	sendBatches(PacketType::UnregisterMCCBatch, _flushedUnregistrations);
+
+	_flushedRegistrations.clear();
+	_flushedUnregistrations.clear();
+}
+
+void MCCRegistrationBatcher::sendBatches(PacketType packetType, const std::vector<PacketRegisterMCCBatch::Entry> &mccs)
+{
+	if (mccs.empty()) {
+		return;
+	}
+
+	// Each MCC goes to the YellowPages partition storing its item
+	std::vector<PacketRegisterMCCBatch> packetData(g_Config.ypPartitions);
+	for (auto &mcc : mccs) {
+		packetData[yellowPagesPartition(mcc.itemId)].mccs.push_back(mcc);
+	}
+
+	for (auto &batch : packetData)
+	{
+		if (batch.mccs.empty()) {
+			continue;
+		}
+
+		PacketHeader packetHead;
+		packetHead.packetType = packetType;
+
+		OutputMemoryStream stream;
+		packetHead.Write(stream);
+		batch.Write(stream);
+
+		// Every replica of the partition gets the batch
+		if (!App->networkManager->sendPacketToYellowPages(batch.mccs.front().itemId, stream, true)) {
+			eLog << "MCCRegistrationBatcher::sendBatches() - Could not connect to the YellowPages";
+			continue;
+		}
+
+		_batchesSent++;
+		_registrationsSent += batch.mccs.size();
+	}
+}
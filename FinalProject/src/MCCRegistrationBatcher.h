@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Packets.h"
+#include <mutex>
+#include <vector>
+
+/**
+ * Aggregator of the MCC (un)registrations, owned by the
+ * ModuleAgentContainer. Instead of sending a packet each, MCCs
+ * queue their (un)registrations here, and once per frame they are
+ * sent as a single batch to each YellowPages partition.
+ */
+class MCCRegistrationBatcher
+{
+public:
+
+	// They queue the (un)registration of a MCC until the next flush
+	// (they can be called from several threads)
+	void registerMCC(AgentId agentId, uint16_t itemId);
+	void unregisterMCC(AgentId agentId, uint16_t itemId);
+
+	// It sends the queued (un)registrations
+	void flush();
+
+	// Metrics
+	uint64_t batchesSent() const { return _batchesSent; }
+	uint64_t registrationsSent() const { return _registrationsSent; }
+
+private:
+
+	// It sends a batch to each YellowPages partition with MCCs in it
+	void sendBatches(PacketType packetType, const std::vector<PacketRegisterMCCBatch::Entry> &mccs);
+
+	std::mutex _mutex; /**< MCCs can be updated from several threads. */
+	std::vector<PacketRegisterMCCBatch::Entry> _registrations; /**< Registrations of this frame. */
+	std::vector<PacketRegisterMCCBatch::Entry> _unregistrations; /**< Unregistrations of this frame. */
+
+	// Queues swapped by flush() (reused every frame)
+	std::vector<PacketRegisterMCCBatch::Entry> _flushedRegistrations;
+	std::vector<PacketRegisterMCCBatch::Entry> _flushedUnregistrations;
+
+	uint64_t _batchesSent = 0; /**< Batch packets sent. */
+	uint64_t _registrationsSent = 0; /**< (Un)registrations sent in them. */
+};
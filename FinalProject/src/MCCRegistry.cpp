@@ -0,0 +1,117 @@
+#include "MCCRegistry.h"
+#include "Packets.h"
+
+
+size_t MCCRegistry::LocationKeyHash::operator()(const LocationKey &key) const
+{
+	size_t hash = std::hash<std::string>()(key.hostIP);
+	hash = hash * 31 + key.hostPort;
+	hash = hash * 31 + key.agentId;
+	return hash;
+}
+
+MCCRegistry::LocationKey MCCRegistry::makeKey(const AgentLocation &mcc)
+{
+	LocationKey key;
+	key.hostIP = mcc.hostIP;
+	key.hostPort = mcc.hostPort;
+	key.agentId = mcc.agentId;
+	return key;
+}
+
+bool MCCRegistry::registerMCC(uint16_t itemId, const AgentLocation &mcc)
+{
+	Shard &s = shard(itemId);
+	std::lock_guard<std::mutex> lock(s.mutex);
+
+	ItemEntry &entry = s.items[itemId];
+	auto inserted = entry.positions.emplace(makeKey(mcc), entry.mccs.size());
+	if (!inserted.second) {
+		return false;
+	}
+	entry.mccs.push_back(mcc);
+	entry.response = nullptr;
+	s.mccCount++;
+	return true;
+}
+
+bool MCCRegistry::unregisterMCC(uint16_t itemId, const AgentLocation &mcc)
+{
+	Shard &s = shard(itemId);
+	std::lock_guard<std::mutex> lock(s.mutex);
+
+	auto itemIt = s.items.find(itemId);
+	if (itemIt == s.items.end()) {
+		return false;
+	}
+
+	ItemEntry &entry = itemIt->second;
+	auto positionIt = entry.positions.find(makeKey(mcc));
+	if (positionIt == entry.positions.end()) {
+		return false;
+	}
+
+	// Swap with the last MCC to remove in constant time
+	const size_t position = positionIt->second;
+	entry.positions.erase(positionIt);
+	if (position != entry.mccs.size() - 1) {
+		entry.mccs[position] = std::move(entry.mccs.back());
+		entry.positions[makeKey(entry.mccs[position])] = position;
+	}
+	entry.mccs.pop_back();
+	entry.response = nullptr;
+	s.mccCount--;
+
+	if (entry.mccs.empty()) {
+		s.items.erase(itemIt);
+	}
+	return true;
+}
+
+MCCRegistry::SerializedMCCs MCCRegistry::serializedMCCs(uint16_t itemId)
+{
+	Shard &s = shard(itemId);
+	std::lock_guard<std::mutex> lock(s.mutex);
+
+	auto itemIt = s.items.find(itemId);
+	if (itemIt == s.items.end())
+	{
+		// Empty list
+		static const SerializedMCCs emptyResponse = []() {
+			OutputMemoryStream stream;
+			PacketReturnMCCsForItem().Write(stream);
+			return std::make_shared<const std::vector<char>>(stream.GetBufferPtr(), stream.GetBufferPtr() + stream.GetSize());
+		}();
+		return emptyResponse;
+	}
+
+	// Serialize only after changes
+	ItemEntry &entry = itemIt->second;
+	if (entry.response == nullptr)
+	{
+		OutputMemoryStream stream;
+		PacketReturnMCCsForItem::Write(stream, entry.mccs);
+		entry.response = std::make_shared<const std::vector<char>>(stream.GetBufferPtr(), stream.GetBufferPtr() + stream.GetSize());
+	}
+	return entry.response;
+}
+
+size_t MCCRegistry::size() const
+{
+	size_t count = 0;
+	for (auto &s : _shards) {
+		std::lock_guard<std::mutex> lock(s.mutex);
+		count += s.mccCount;
+	}
+	return count;
+}
+
+void MCCRegistry::visit(const std::function<void(uint16_t, const std::vector<AgentLocation> &)> &visitor) const
+{
+	for (auto &s : _shards) {
+		std::lock_guard<std::mutex> lock(s.mutex);
+		for (auto &item : s.items) {
+			visitor(item.first, item.second.mccs);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "AgentLocation.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Registry of the MCC agents contributing each item, used by the
+ * ModuleYellowPages. Items are spread across shards (each with its
+ * own lock), registrations are indexed by location so unregistering
+ * is constant time, and the serialized list of MCCs of each item is
+ * cached until the item changes.
+ */
+class MCCRegistry
+{
+public:
+
+	/** Serialized PacketReturnMCCsForItem body (shared with senders). */
+	using SerializedMCCs = std::shared_ptr<const std::vector<char>>;
+
+	// It registers a MCC contributing the given item (false if it was already registered)
+	bool registerMCC(uint16_t itemId, const AgentLocation &mcc);
+
+	// It unregisters a MCC (false if it was not registered)
+	bool unregisterMCC(uint16_t itemId, const AgentLocation &mcc);
+
+	// It returns the PacketReturnMCCsForItem body for the given item
+	SerializedMCCs serializedMCCs(uint16_t itemId);
+
+	// Number of registered MCCs
+	size_t size() const;
+
+	// It calls the visitor for each item with registered MCCs
+	void visit(const std::function<void(uint16_t, const std::vector<AgentLocation> &)> &visitor) const;
+
+private:
+
+	/** Key identifying a MCC (agent ids are only unique within a host). */
+	struct LocationKey
+	{
+		std::string hostIP;
+		uint16_t hostPort;
+		AgentId agentId;
+
+		bool operator==(const LocationKey &other) const {
+			return agentId == other.agentId && hostPort == other.hostPort && hostIP == other.hostIP;
+		}
+	};
+
+	struct LocationKeyHash
+	{
+		size_t operator()(const LocationKey &key) const;
+	};
+
+	/** MCCs of one item. */
+	struct ItemEntry
+	{
+		std::vector<AgentLocation> mccs; /**< Registered MCCs (unordered). */
+		std::unordered_map<LocationKey, size_t, LocationKeyHash> positions; /**< Index of each MCC in mccs. */
+		SerializedMCCs response; /**< Cached response (null after changes). */
+	};
+
+	struct Shard
+	{
+		mutable std::mutex mutex;
+		std::unordered_map<uint16_t, ItemEntry> items;
+		size_t mccCount = 0;
+	};
+
+	static const size_t SHARD_COUNT = 16;
+
+	Shard &shard(uint16_t itemId) { return _shards[itemId % SHARD_COUNT]; }
+
+	static LocationKey makeKey(const AgentLocation &mcc);
+
+	Shard _shards[SHARD_COUNT]; /**< Items spread by id. */
+};
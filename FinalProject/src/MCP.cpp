@@ -2,6 +2,9 @@
 #include "UCP.h"
 #include "Application.h"
 #include "ModuleAgentContainer.h"
+#include "ModuleNodeCluster.h"
+#include "Metrics.h"
+#include <algorithm>
 
 
 enum State
@@ -19,7 +22,8 @@ MCP::MCP(Node *node, uint16_t requestedItemID, uint16_t contributedItemID, unsig
 	Agent(node),
 	_requestedItemId(requestedItemID),
 	_contributedItemId(contributedItemID),
-	_searchDepth(searchDepth)
+	_searchDepth(searchDepth),
+	_creationTime(std::chrono::steady_clock::now())
 {
 	setState(ST_INIT);
 }
@@ -28,19 +32,39 @@ MCP::~MCP()
 {
 }
 
+double MCP::ageMillis() const
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _creationTime).count();
+}
+
 void MCP::update()
 {
 	switch (state())
 	{
 	case ST_INIT:
-		queryMCCsForItem(_requestedItemId);
-		setState(ST_REQUESTING_MCCs);
+		// Searches start right away if the node already knows the MCCs
+		if (App->modNodeCluster->mccDirectory().getMCCsForItem(_requestedItemId, _mccRegisters)) {
+			static const Metrics::Id directoryHits = g_Metrics.counter("mcp.directory_hits");
+			g_Metrics.add(directoryHits);
+			_mccRegisterIndex = 0;
+			setState(ST_ITERATING_OVER_MCCs);
+		}
+		else {
+			static const Metrics::Id yellowPagesQueries = g_Metrics.counter("mcp.yp_queries");
+			g_Metrics.add(yellowPagesQueries);
+			queryMCCsForItem(_requestedItemId);
+			setState(ST_REQUESTING_MCCs);
+			setStateTimeout(YP_REQUEST_TIMEOUT_MILLIS);
+		}
 		break;
 
 	case ST_ITERATING_OVER_MCCs:
-		// TODO: Handle this state
-		if (_mccRegisterIndex < _mccRegisters.size()) {
+		// Several MCCs are asked at the same time, the first acceptance wins
+		while (_pendingNegotiations.size() < MCP_NEGOTIATION_FANOUT && _mccRegisterIndex < (int)_mccRegisters.size()) {
 			CreateNegotiation(_mccRegisters[_mccRegisterIndex]);
+			_mccRegisterIndex++;
+		}
+		if (!_pendingNegotiations.empty()) {
 			setState(ST_WAITING_ACCEPTANCE);
 		}
 		else {
@@ -49,6 +73,12 @@ void MCP::update()
 		}
 		break;
 	case ST_WAITING_ACCEPTANCE:
+		// Rejected or expired requests leave room for the next MCCs
+		ExpireNegotiations();
+		if (_pendingNegotiations.empty() ||
+			(_pendingNegotiations.size() < MCP_NEGOTIATION_FANOUT && _mccRegisterIndex < (int)_mccRegisters.size())) {
+			setState(ST_ITERATING_OVER_MCCs);
+		}
 		break;
 
 	// TODO: Handle other states
@@ -60,7 +90,6 @@ void MCP::update()
 			}
 			else if (UCP->success == false) { // Negotiation failed
 				setState(ST_ITERATING_OVER_MCCs);
-				_mccRegisterIndex++;
 			}
 		}
 		break;
@@ -77,6 +106,13 @@ void MCP::stop()
 	// TODO: Destroy the underlying search hierarchy (UCP->MCP->UCP->...)
 	
 	DestroyChildUCP();
+
+	// MCCs that may have accepted are not needed anymore
+	for (auto &pending : _pendingNegotiations) {
+		ReleaseNegotiation(pending.mcc);
+	}
+	_pendingNegotiations.clear();
+
 	destroy();
 }
 
@@ -89,6 +125,10 @@ void MCP::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 	case PacketType::ReturnMCCsForItem:
 		if (state() == ST_REQUESTING_MCCs)
 		{
+			// Round trip of the query to the YellowPages
+			static const Metrics::Id queryTime = g_Metrics.histogram("yp.query_us");
+			g_Metrics.record(queryTime, stateElapsedMicros());
+
 			// Read the packet
 			PacketReturnMCCsForItem packetData;
 			packetData.Read(stream);
@@ -96,7 +136,7 @@ void MCP::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 			// Log the returned MCCs
 			for (auto &mccdata : packetData.mccAddresses)
 			{
-				uint16_t agentId = mccdata.agentId;
+				AgentId agentId = mccdata.agentId;
 				const std::string &hostIp = mccdata.hostIP;
 				uint16_t hostPort = mccdata.hostPort;
 				//iLog << " - MCC: " << agentId << " - host: " << hostIp << ":" << hostPort;
@@ -108,10 +148,8 @@ void MCP::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 			// Select the first MCC to negociate
 			_mccRegisterIndex = 0;
 			setState(ST_ITERATING_OVER_MCCs);
-
-			socket->Disconnect();
 		}
-		else
+		else if (!_exchangeCommitted)
 		{
 			wLog << "OnPacketReceived() - PacketType::ReturnMCCsForItem was unexpected.";
 		}
@@ -119,20 +157,59 @@ void MCP::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 
 	// TODO: Handle other packets
 	case PacketType::ReturnForNegotiation:
-		if (state() == ST_WAITING_ACCEPTANCE) {
-			ResponseForNegotiation packetBody;
-			packetBody.Read(stream);
+	{
+		ResponseForNegotiation packetBody;
+		packetBody.Read(stream);
+
+		const std::string hostIP = socket->RemoteAddress().GetIPString();
+		auto it = std::find_if(_pendingNegotiations.begin(), _pendingNegotiations.end(), [&](const PendingNegotiation &pending) {
+			return pending.mcc.agentId == packetHeader.srcAgentId && pending.mcc.hostIP == hostIP;
+		});
+		if (it == _pendingNegotiations.end())
+		{
+			// Expired or released meanwhile (released again in case the release was lost)
 			if (packetBody.success == true) {
-				iLog << "MCP::Accepted Negotiation";
-				CreateChildUCP(packetBody.LocationUCC);
-				setState(ST_NEGOTIATIONS);
+				AgentLocation mccLocation;
+				mccLocation.hostIP = hostIP;
+				mccLocation.hostPort = LISTEN_PORT_AGENTS;
+				mccLocation.agentId = packetHeader.srcAgentId;
+				ReleaseNegotiation(mccLocation);
 			}
-			else {
-				setState(ST_ITERATING_OVER_MCCs);
-				_mccRegisterIndex++;
+			break;
+		}
+		const AgentLocation mccLocation = it->mcc;
+		_pendingNegotiations.erase(it);
+
+		// Rejections are handled in ST_WAITING_ACCEPTANCE
+		if (packetBody.success == false) {
+			break;
+		}
+
+		// Answers can also arrive while more MCCs are being asked
+		if (state() == ST_WAITING_ACCEPTANCE || state() == ST_ITERATING_OVER_MCCs) {
+			iLog << "MCP::Accepted Negotiation";
+
+			// The rest of the MCCs asked are not needed
+			for (auto &pending : _pendingNegotiations) {
+				ReleaseNegotiation(pending.mcc);
 			}
+			_pendingNegotiations.clear();
+
+			CreateChildUCP(packetBody.LocationUCC);
+			if (UCP == nullptr) {
+				// No agent could be created, the search finishes without agreement
+				ReleaseNegotiation(mccLocation);
+				setState(ST_NEGOTIATION_FINISHED);
+				break;
+			}
+			setState(ST_NEGOTIATIONS);
+		}
+		else {
+			// The search finished meanwhile, so the MCC must not wait for it
+			ReleaseNegotiation(mccLocation);
 		}
 		break;
+	}
 	default:
 		wLog << "OnPacketReceived() - Unexpected PacketType.";
 	}
@@ -143,8 +220,34 @@ bool MCP::negotiationFinished() const
 	return state() == ST_NEGOTIATION_FINISHED;
 }
 
+void MCP::OnTimeout()
+{
+	if (state() == ST_REQUESTING_MCCs)
+	{
+		// Without MCCs, the search finishes without agreement
+		wLog << "MCP::YellowPages query timed out";
+		_mccRegisters.clear();
+		_mccRegisterIndex = 0;
+		setState(ST_ITERATING_OVER_MCCs);
+	}
+}
+
+bool MCP::isWaitingForMCCs() const
+{
+	return state() == ST_INIT || state() == ST_REQUESTING_MCCs;
+}
+
+void MCP::commitExchange()
+{
+	_exchangeCommitted = true;
+	setState(ST_NEGOTIATION_FINISHED);
+}
+
 bool MCP::negotiationAgreement() const
 {
+	if (_exchangeCommitted) {
+		return true;
+	}
 	if (UCP != nullptr) {
 		return UCP->success == true; // TODO: Did the child UCP find a solution?
 	}
@@ -169,7 +272,7 @@ bool MCP::queryMCCsForItem(int itemId)
 	packetData.Write(stream);
 
 	// 1) Ask YP for MCC hosting the item 'itemId'
-	return sendPacketToYellowPages(stream);
+	return sendPacketToYellowPages(_requestedItemId, stream);
 }
 
 void MCP::CreateChildUCP(AgentLocation & LocationUCC)
@@ -199,12 +302,52 @@ bool MCP::CreateNegotiation(AgentLocation & LOCATIONMCC)
 	PacketNegotiationRequest body;
 	body._requestedItemId = requestedItemId();
 	body._contributedItemId = contributedItemId();
+	body._searchDepth = (uint16_t)searchDepth();
 
 	OutputMemoryStream stream;
 	packethead.Write(stream);
 	body.Write(stream);
 
 	iLog << "MCP::Asking Negotiation";
-	return sendPacketToAgent(LOCATIONMCC.hostIP, LOCATIONMCC.hostPort, stream);
+	if (!sendPacketToAgent(LOCATIONMCC.hostIP, LOCATIONMCC.hostPort, stream)) {
+		return false;
+	}
+
+	PendingNegotiation pending;
+	pending.mcc = LOCATIONMCC;
+	pending.sentTime = std::chrono::steady_clock::now();
+	_pendingNegotiations.push_back(pending);
+	return true;
+}
+
+bool MCP::ReleaseNegotiation(const AgentLocation &mccLocation)
+{
+	PacketHeader packethead;
+	packethead.packetType = PacketType::ReleaseNegotiation;
+	packethead.dstAgentId = mccLocation.agentId;
+	packethead.srcAgentId = this->id();
+
+	OutputMemoryStream stream;
+	packethead.Write(stream);
+
+	return sendPacketToAgent(mccLocation.hostIP, mccLocation.hostPort, stream);
+}
 
+void MCP::ExpireNegotiations()
+{
+	const auto now = std::chrono::steady_clock::now();
+	const auto timeout = std::chrono::milliseconds(NEGOTIATION_TIMEOUT_MILLIS);
+
+	for (auto it = _pendingNegotiations.begin(); it != _pendingNegotiations.end(); )
+	{
+		if (now - it->sentTime > timeout) {
+			// In case the answer is just late
+			wLog << "MCP::Negotiation request expired";
+			ReleaseNegotiation(it->mcc);
+			it = _pendingNegotiations.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
 }
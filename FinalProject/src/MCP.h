@@ -1,5 +1,6 @@
 #pragma once
 #include "Agent.h"
+#include <chrono>
 
 // Forward declaration
 class UCP;
@@ -19,6 +20,7 @@ public:
 	void stop() override;
 	MCP* asMCP() override { return this; }
 	void OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader, InputMemoryStream &stream) override;
+	void OnTimeout() override;
 
 	// Getters
 	uint16_t requestedItemId() const { return _requestedItemId; }
@@ -33,6 +35,19 @@ public:
 	// It returns the search depth of this MCP
 	unsigned int searchDepth() const { return _searchDepth; }
 
+	// Whether or not the MCP did not contact any MCC yet
+	bool isWaitingForMCCs() const;
+
+	// It finishes the search with an agreement found elsewhere
+	// (used by the centralized ExchangeSolver)
+	void commitExchange();
+
+	// Whether or not the agreement came from commitExchange()
+	bool exchangeCommitted() const { return _exchangeCommitted; }
+
+	// Milliseconds since the MCP was created
+	double ageMillis() const;
+
 private:
 
 	bool queryMCCsForItem(int itemId);
@@ -45,11 +60,30 @@ private:
 
 	unsigned int _searchDepth;
 
+	bool _exchangeCommitted = false; /**< Agreement found by the ExchangeSolver. */
+
+	std::chrono::steady_clock::time_point _creationTime; /**< Start of the search (for latency metrics). */
+
 	void CreateChildUCP(AgentLocation &LocationUCC);
 	void DestroyChildUCP();
 
 	bool CreateNegotiation(AgentLocation &LOCATIONMCC);
 
+	// It tells a MCC that accepted (or may accept) the negotiation that it is not needed
+	bool ReleaseNegotiation(const AgentLocation &mccLocation);
+
+	// It gives up the requests without answer after NEGOTIATION_TIMEOUT_MILLIS
+	void ExpireNegotiations();
+
+	/** RequestForNegotiation waiting for the answer of the MCC. */
+	struct PendingNegotiation
+	{
+		AgentLocation mcc;
+		std::chrono::steady_clock::time_point sentTime;
+	};
+
+	std::vector<PendingNegotiation> _pendingNegotiations; /**< Up to MCP_NEGOTIATION_FANOUT requests. */
+
 	UCPPtr UCP;
 };
 
@@ -0,0 +1,256 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <sstream>
+
+Metrics g_Metrics;
+
+
+Metrics::Metrics()
+{
+}
+
+Metrics::~Metrics()
+{
+	for (auto &shard : _shards) {
+		for (auto &histogram : shard->histograms) {
+			delete histogram.load();
+		}
+	}
+}
+
+Metrics::Id Metrics::counter(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto it = std::find(_counterNames.begin(), _counterNames.end(), name);
+	if (it != _counterNames.end()) {
+		return (Id)(it - _counterNames.begin());
+	}
+	_counterNames.push_back(name);
+	return (Id)_counterNames.size() - 1;
+}
+
+Metrics::Id Metrics::histogram(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto it = std::find(_histogramNames.begin(), _histogramNames.end(), name);
+	if (it != _histogramNames.end()) {
+		return (Id)(it - _histogramNames.begin());
+	}
+	_histogramNames.push_back(name);
+	return (Id)_histogramNames.size() - 1;
+}
+
+void Metrics::add(Id counterId, uint64_t value)
+{
+	if (counterId >= MAX_COUNTERS) {
+		return;
+	}
+
+	// Only this thread writes the shard, so there is no need for a read-modify-write
+	std::atomic<uint64_t> &counter = localShard().counters[counterId];
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void Metrics::record(Id histogramId, uint64_t value)
+{
+	if (histogramId >= MAX_HISTOGRAMS) {
+		return;
+	}
+
+	Shard &shard = localShard();
+	HistogramShard *histogram = shard.histograms[histogramId].load(std::memory_order_acquire);
+	if (histogram == nullptr)
+	{
+		histogram = new HistogramShard();
+		for (auto &bucket : histogram->buckets) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		histogram->count.store(0, std::memory_order_relaxed);
+		histogram->sum.store(0, std::memory_order_relaxed);
+		histogram->max.store(0, std::memory_order_relaxed);
+		shard.histograms[histogramId].store(histogram, std::memory_order_release);
+	}
+
+	std::atomic<uint64_t> &bucket = histogram->buckets[bucketIndex(value)];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	histogram->count.store(histogram->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	histogram->sum.store(histogram->sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	if (value > histogram->max.load(std::memory_order_relaxed)) {
+		histogram->max.store(value, std::memory_order_relaxed);
+	}
+}
+
+void Metrics::snapshot(Snapshot &snapshot)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	snapshot.counters.resize(std::min<size_t>(_counterNames.size(), MAX_COUNTERS));
+	for (size_t id = 0; id < snapshot.counters.size(); ++id)
+	{
+		CounterValue &counter = snapshot.counters[id];
+		counter.name = _counterNames[id];
+		counter.value = 0;
+		for (auto &shard : _shards) {
+			counter.value += shard->counters[id].load(std::memory_order_relaxed);
+		}
+	}
+
+	std::vector<uint64_t> buckets(BUCKET_COUNT);
+	snapshot.histograms.resize(std::min<size_t>(_histogramNames.size(), MAX_HISTOGRAMS));
+	for (size_t id = 0; id < snapshot.histograms.size(); ++id)
+	{
+		HistogramValue &histogram = snapshot.histograms[id];
+		histogram.name = _histogramNames[id];
+		histogram.count = 0;
+		histogram.sum = 0;
+		histogram.max = 0;
+		std::fill(buckets.begin(), buckets.end(), 0);
+
+		for (auto &shard : _shards)
+		{
+			HistogramShard *histogramShard = shard->histograms[id].load(std::memory_order_acquire);
+			if (histogramShard == nullptr) {
+				continue;
+			}
+			for (unsigned int i = 0; i < BUCKET_COUNT; ++i) {
+				buckets[i] += histogramShard->buckets[i].load(std::memory_order_relaxed);
+			}
+			histogram.count += histogramShard->count.load(std::memory_order_relaxed);
+			histogram.sum += histogramShard->sum.load(std::memory_order_relaxed);
+			histogram.max = std::max(histogram.max, histogramShard->max.load(std::memory_order_relaxed));
+		}
+
+		// Buckets are read one by one, so their total can differ a bit from count
+		uint64_t total = 0;
+		for (auto bucket : buckets) {
+			total += bucket;
+		}
+
+		// Nearest-rank percentiles
+		uint64_t *percentiles[] = { &histogram.p50, &histogram.p90, &histogram.p99 };
+		const double ranks[] = { 0.50, 0.90, 0.99 };
+		for (int p = 0; p < 3; ++p)
+		{
+			*percentiles[p] = 0;
+			const uint64_t rank = std::max<uint64_t>(1, (uint64_t)(ranks[p] * total + 0.5));
+			uint64_t accumulated = 0;
+			for (unsigned int i = 0; i < BUCKET_COUNT && total > 0; ++i)
+			{
+				accumulated += buckets[i];
+				if (accumulated >= rank) {
+					*percentiles[p] = std::min(bucketValue(i), histogram.max);
+					break;
+				}
+			}
+		}
+	}
+}
+
+void Metrics::toText(const Snapshot &snapshot, std::vector<std::string> &lines)
+{
+	for (auto &counter : snapshot.counters)
+	{
+		if (counter.value == 0) {
+			continue;
+		}
+		std::ostringstream line;
+		line << counter.name << " = " << counter.value;
+		lines.push_back(line.str());
+	}
+	for (auto &histogram : snapshot.histograms)
+	{
+		if (histogram.count == 0) {
+			continue;
+		}
+		std::ostringstream line;
+		line << histogram.name << ": count " << histogram.count
+			<< ", mean " << (histogram.count > 0 ? histogram.sum / histogram.count : 0)
+			<< ", p50 " << histogram.p50 << ", p90 " << histogram.p90
+			<< ", p99 " << histogram.p99 << ", max " << histogram.max;
+		lines.push_back(line.str());
+	}
+}
+
+std::string Metrics::toJSON(const Snapshot &snapshot)
+{
+	// Metric names are plain identifiers, so they need no escaping
+	std::ostringstream json;
+	json << "{\"counters\":{";
+	for (size_t i = 0; i < snapshot.counters.size(); ++i)
+	{
+		const CounterValue &counter = snapshot.counters[i];
+		json << (i > 0 ? "," : "") << "\"" << counter.name << "\":" << counter.value;
+	}
+	json << "},\"histograms\":{";
+	for (size_t i = 0; i < snapshot.histograms.size(); ++i)
+	{
+		const HistogramValue &histogram = snapshot.histograms[i];
+		json << (i > 0 ? "," : "") << "\"" << histogram.name << "\":{"
+			<< "\"count\":" << histogram.count
+			<< ",\"sum\":" << histogram.sum
+			<< ",\"max\":" << histogram.max
+			<< ",\"p50\":" << histogram.p50
+			<< ",\"p90\":" << histogram.p90
+			<< ",\"p99\":" << histogram.p99 << "}";
+	}
+	json << "}}";
+	return json.str();
+}
+
+unsigned int Metrics::bucketIndex(uint64_t value)
+{
+	if (value < SUB_BUCKETS) {
+		return (unsigned int)value;
+	}
+
+	// Position of the highest bit set (binary search)
+	unsigned int highestBit = 0;
+	for (unsigned int shift = 32; shift > 0; shift /= 2) {
+		if ((value >> (highestBit + shift)) != 0) {
+			highestBit += shift;
+		}
+	}
+
+	// The bits below the highest one select the sub-bucket
+	const unsigned int exponent = highestBit - SUB_BUCKET_BITS;
+	const unsigned int subBucket = (unsigned int)(value >> exponent) & (SUB_BUCKETS - 1);
+	return SUB_BUCKETS + exponent * SUB_BUCKETS + subBucket;
+}
+
+uint64_t Metrics::bucketValue(unsigned int index)
+{
+	if (index < SUB_BUCKETS) {
+		return index;
+	}
+
+	const unsigned int exponent = (index - SUB_BUCKETS) / SUB_BUCKETS;
+	const unsigned int subBucket = (index - SUB_BUCKETS) % SUB_BUCKETS;
+	const uint64_t lowest = (uint64_t)(SUB_BUCKETS + subBucket) << exponent;
+	const uint64_t width = (uint64_t)1 << exponent;
+	return lowest + width / 2;
+}
+
+Metrics::Shard &Metrics::localShard()
+{
+	thread_local Metrics *owner = nullptr;
+	thread_local Shard *shard = nullptr;
+	if (owner == this) {
+		return *shard;
+	}
+
+	std::unique_ptr<Shard> newShard(new Shard());
+	for (auto &counter : newShard->counters) {
+		counter.store(0, std::memory_order_relaxed);
+	}
+	for (auto &histogram : newShard->histograms) {
+		histogram.store(nullptr, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	owner = this;
+	shard = newShard.get();
+	_shards.push_back(std::move(newShard));
+	return *shard;
+}
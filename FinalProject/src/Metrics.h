@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Registry of runtime metrics: counters and histograms.
+ *
+ * Metrics are registered by name (the same name always returns the
+ * same id), and callers keep the ids, e.g. in function-local statics.
+ * Updates can come from any thread without locks: each thread writes
+ * into its own shard, and the shards are only added up by snapshot().
+ *
+ * Histograms are log-linear (HDR-style): values are grouped by their
+ * highest bit and then into 8 sub-buckets, so percentiles are known
+ * with an error below 12.5% with a few hundred buckets.
+ */
+class Metrics
+{
+public:
+
+	using Id = unsigned int;
+
+	static const Id MAX_COUNTERS = 256;
+	static const Id MAX_HISTOGRAMS = 128;
+
+	Metrics();
+	~Metrics();
+
+	// Registration (ids beyond the maximum are ignored by the updates)
+	Id counter(const std::string &name);
+	Id histogram(const std::string &name);
+
+	// Updates (from any thread)
+	void add(Id counterId, uint64_t value = 1);
+	void record(Id histogramId, uint64_t value);
+
+	/** Counter added up over all the threads. */
+	struct CounterValue
+	{
+		std::string name;
+		uint64_t value;
+	};
+
+	/** Histogram added up over all the threads. */
+	struct HistogramValue
+	{
+		std::string name;
+		uint64_t count;
+		uint64_t sum;
+		uint64_t max;
+		uint64_t p50;
+		uint64_t p90;
+		uint64_t p99;
+	};
+
+	/** Values of all the metrics at a given moment. */
+	struct Snapshot
+	{
+		std::vector<CounterValue> counters;
+		std::vector<HistogramValue> histograms;
+	};
+
+	void snapshot(Snapshot &snapshot);
+
+	// Dumps of a snapshot (one line per metric with values, or a single JSON object)
+	static void toText(const Snapshot &snapshot, std::vector<std::string> &lines);
+	static std::string toJSON(const Snapshot &snapshot);
+
+private:
+
+	static const unsigned int SUB_BUCKET_BITS = 3;
+	static const unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const unsigned int BUCKET_COUNT = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+	static unsigned int bucketIndex(uint64_t value);
+	static uint64_t bucketValue(unsigned int index); // Middle of the bucket
+
+	/** Histogram of a thread. */
+	struct HistogramShard
+	{
+		std::atomic<uint64_t> buckets[BUCKET_COUNT];
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> sum;
+		std::atomic<uint64_t> max;
+	};
+
+	/** Metrics of a thread (only that thread writes them). */
+	struct Shard
+	{
+		std::atomic<uint64_t> counters[MAX_COUNTERS];
+		std::atomic<HistogramShard*> histograms[MAX_HISTOGRAMS]; /**< Allocated when first used. */
+	};
+
+	// It returns the shard of the calling thread (creating it the first time)
+	Shard &localShard();
+
+	std::mutex _mutex; /**< It protects the names and the list of shards. */
+	std::vector<std::string> _counterNames; /**< Index is the id. */
+	std::vector<std::string> _histogramNames; /**< Index is the id. */
+	std::vector<std::unique_ptr<Shard>> _shards; /**< Shards of all the threads (kept after they finish). */
+};
+
+extern Metrics g_Metrics;
+
+
+/**
+ * It records the lifetime of the scope, in microseconds, into a histogram.
+ */
+class ScopedTimer
+{
+public:
+
+	explicit ScopedTimer(Metrics::Id histogramId) :
+		_histogramId(histogramId),
+		_start(std::chrono::steady_clock::now())
+	{ }
+
+	~ScopedTimer()
+	{
+		const auto elapsed = std::chrono::steady_clock::now() - _start;
+		g_Metrics.record(_histogramId, (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+	}
+
+private:
+
+	Metrics::Id _histogramId;
+	std::chrono::steady_clock::time_point _start;
+};
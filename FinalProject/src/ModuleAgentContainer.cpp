@@ -3,7 +3,12 @@
 #include "MCP.h"
 #include "UCC.h"
 #include "UCP.h"
+#include "Node.h"
+#include "Globals.h"
+#include "Log.h"
 #include "imgui/imgui.h"
+#include <algorithm>
+#include <unordered_map>
 
 
 ModuleAgentContainer::ModuleAgentContainer()
@@ -17,79 +22,223 @@ ModuleAgentContainer::~ModuleAgentContainer()
 MCCPtr ModuleAgentContainer::createMCC(Node *node, uint16_t contributedItemId, uint16_t constraintItemId)
 {
 	MCCPtr mcc(new MCC(node, contributedItemId, constraintItemId));
-	addAgent(mcc);
-	return mcc;
+	return addAgent(mcc) ? mcc : nullptr;
 }
 
 MCPPtr ModuleAgentContainer::createMCP(Node *node, uint16_t requestedItemId, uint16_t contributedItemId, unsigned int searchDepth)
 {
 	MCPPtr mcp(new MCP(node, requestedItemId, contributedItemId, searchDepth));
-	addAgent(mcp);
-	return mcp;
+	return addAgent(mcp) ? mcp : nullptr;
 }
 
-UCCPtr ModuleAgentContainer::createUCC(Node *node, uint16_t contributedItemId, uint16_t constraintItemId)
+UCCPtr ModuleAgentContainer::createUCC(Node *node, uint16_t contributedItemId, uint16_t constraintItemId, unsigned int searchDepth)
 {
-	UCCPtr ucc(new UCC(node, contributedItemId, constraintItemId));
-	addAgent(ucc);
-	return ucc;
+	UCCPtr ucc(new UCC(node, contributedItemId, constraintItemId, searchDepth));
+	return addAgent(ucc) ? ucc : nullptr;
 }
 
 UCPPtr ModuleAgentContainer::createUCP(Node *node, uint16_t requestedItemId, uint16_t contributedItemId, const AgentLocation &uccLocation, unsigned int searchDepth)
 {
 	UCPPtr ucp(new UCP(node, requestedItemId, contributedItemId, uccLocation, searchDepth));
-	addAgent(ucp);
-	return ucp;
+	return addAgent(ucp) ? ucp : nullptr;
 }
 
-void ModuleAgentContainer::addAgent(AgentPtr agent)
+bool ModuleAgentContainer::addAgent(AgentPtr agent)
 {
+	std::lock_guard<std::mutex> lock(_agentsToAddMutex);
+	if (!allocateId(agent.get())) {
+		eLog << "ModuleAgentContainer::addAgent() - There are already " << MAX_AGENTS << " agents";
+		return false;
+	}
+	_slots[agent->id() & 0xffff].agent = agent;
 	_agentsToAdd.push_back(agent);
+	return true;
 }
 
-AgentPtr ModuleAgentContainer::getAgent(int agentId)
+size_t ModuleAgentContainer::freeAgentCount()
 {
-	// Agent search
-	for (auto agent : _agents) {
-		if (agent->id() == agentId) {
-			return agent;
-		}
+	std::lock_guard<std::mutex> lock(_agentsToAddMutex);
+	return MAX_AGENTS - _slots.size() + _freeSlots.size();
+}
+
+bool ModuleAgentContainer::allocateId(Agent *agent)
+{
+	uint16_t slotIndex;
+	if (!_freeSlots.empty()) {
+		slotIndex = _freeSlots.front();
+		_freeSlots.pop_front();
+	}
+	else if (_slots.size() < MAX_AGENTS) {
+		slotIndex = (uint16_t)_slots.size();
+		_slots.emplace_back();
+	}
+	else {
+		// Every slot has a live agent, and ids must not be shared
+		return false;
 	}
-	for (auto agent : _agentsToAdd) {
-		if (agent->id() == agentId) {
-			return agent;
+
+	agent->_id = ((AgentId)_slots[slotIndex].generation << 16) | slotIndex;
+	return true;
+}
+
+void ModuleAgentContainer::releaseId(Agent *agent)
+{
+	const uint16_t slotIndex = agent->id() & 0xffff;
+	AgentSlot &slot = _slots[slotIndex];
+	slot.agent = nullptr;
+
+	// Generation 0 is skipped so that no id equals NULL_AGENT_ID
+	slot.generation++;
+	if (slot.generation == 0) {
+		slot.generation = 1;
+	}
+	_freeSlots.push_back(slotIndex);
+}
+
+void ModuleAgentContainer::setUpdateThreadCount(int threadCount)
+{
+	_scheduler.start(threadCount);
+}
+
+AgentPtr ModuleAgentContainer::getAgent(uint32_t agentId)
+{
+	// Ids of destroyed agents have an old generation
+	const uint32_t slotIndex = agentId & 0xffff;
+	if (slotIndex < _slots.size()) {
+		const AgentSlot &slot = _slots[slotIndex];
+		if (slot.agent != nullptr && slot.agent->id() == agentId) {
+			return slot.agent;
 		}
 	}
 
 	return nullptr;
 }
 
+void ModuleAgentContainer::scheduleTimeout(Agent *agent, unsigned int millis)
+{
+	std::lock_guard<std::mutex> lock(_timersMutex);
+	_timers.schedule(agent->id(), agent->stateSerial(), millis);
+}
+
+void ModuleAgentContainer::expireTimeouts()
+{
+	{
+		std::lock_guard<std::mutex> lock(_timersMutex);
+		_timers.expire(_expiredTimers);
+	}
+
+	for (auto &timer : _expiredTimers)
+	{
+		// Destroyed agents and agents that changed their state meanwhile are skipped
+		AgentPtr agent = getAgent(timer.agentId);
+		if (agent != nullptr && agent->isValid() && agent->stateSerial() == timer.stateSerial) {
+			_timeouts++;
+			agent->OnTimeout();
+		}
+	}
+	_expiredTimers.clear();
+}
+
 bool ModuleAgentContainer::empty() const
 {
 	return _agents.empty();
 }
 
+bool ModuleAgentContainer::init()
+{
+	setUpdateThreadCount(AGENT_UPDATE_THREADS);
+	_metricsStart = Clock::now();
+
+	return true;
+}
+
 bool  ModuleAgentContainer::update()
 {
-	// Update all agents
-	for (auto agent : _agents)
+	// Timeouts are handled before the update, in the main thread
+	expireTimeouts();
+
+	const Clock::time_point updateStart = Clock::now();
+
+	if (updateThreadCount() == 0)
 	{
-		if (agent->isValid()) {
-			agent->update();
+		// Update all agents
+		for (auto agent : _agents)
+		{
+			if (agent->isValid()) {
+				agent->dispatchPackets();
+				agent->update();
+			}
 		}
 	}
+	else
+	{
+		updateInParallel();
+	}
+
+	// All the MCCs registered during the update share the same packets
+	_mccRegistrations.flush();
+
+	// Throughput over windows of one second
+	const Clock::time_point updateEnd = Clock::now();
+	_updateSeconds += std::chrono::duration<double>(updateEnd - updateStart).count();
+	_updatedAgents += _agents.size();
+	if (updateEnd - _metricsStart >= std::chrono::seconds(1))
+	{
+		_agentsPerSecond = (_updateSeconds > 0.0) ? _updatedAgents / _updateSeconds : 0.0;
+		_updateSeconds = 0.0;
+		_updatedAgents = 0;
+		_metricsStart = updateEnd;
+	}
 
 	return true;
 }
 
+void ModuleAgentContainer::updateInParallel()
+{
+	// Agents of the same node can access each other (e.g. a MCC and its
+	// UCC, or a MCP and its UCP), so they are updated in order by the same
+	// task. Agents of different nodes only talk through the network.
+	std::unordered_map<Node*, size_t> groupIndices;
+	size_t groupCount = 0;
+	for (auto &agent : _agents)
+	{
+		auto it = groupIndices.find(agent->node());
+		if (it == groupIndices.end()) {
+			it = groupIndices.emplace(agent->node(), groupCount++).first;
+			if (_nodeGroups.size() < groupCount) {
+				_nodeGroups.resize(groupCount);
+			}
+			_nodeGroups[it->second].clear();
+		}
+		_nodeGroups[it->second].push_back(agent.get());
+	}
+
+	_scheduler.run(groupCount, [this](size_t groupIndex)
+	{
+		for (auto agent : _nodeGroups[groupIndex])
+		{
+			if (agent->isValid()) {
+				agent->dispatchPackets();
+				agent->update();
+			}
+		}
+	});
+}
+
 bool ModuleAgentContainer::postUpdate()
 {
 	// Add pending agents to add
-	for (auto agentToAdd : _agentsToAdd)
+	// (start() may create more agents, added in the next frame)
+	std::vector<AgentPtr> agentsToAdd;
+	{
+		std::lock_guard<std::mutex> lock(_agentsToAddMutex);
+		agentsToAdd.swap(_agentsToAdd);
+	}
+	for (auto agentToAdd : agentsToAdd)
 	{
 		_agents.push_back(agentToAdd);
+		agentToAdd->start();
 	}
-	_agentsToAdd.clear();
 
 	// Track alive agents
 	std::vector<AgentPtr> agentsAlive;
@@ -101,10 +250,14 @@ bool ModuleAgentContainer::postUpdate()
 		if (agent->isValid()) {
 			agentsAlive.push_back(agent);
 		}
+		else {
+			releaseId(agent.get());
+		}
 	}
 
 	// Remove finished agents
 	_agents.swap(agentsAlive);
+	_peakAgentCount = std::max(_peakAgentCount, _agents.size());
 
 	return true;
 }
@@ -116,12 +269,21 @@ bool ModuleAgentContainer::stop()
 		agent->stop();
 	}
 
+	// Send their unregistrations before the network is finalized
+	_mccRegistrations.flush();
+
 	return true;
 }
 
 bool ModuleAgentContainer::cleanUp()
 {
+	_scheduler.stop();
+	_timers.clear();
+	_nodeGroups.clear();
 	_agents.clear();
+	_slots.clear();
+	_freeSlots.clear();
+	_peakAgentCount = 0;
 
 	return true;
 }
@@ -146,5 +308,17 @@ void ModuleAgentContainer::drawInfoGUI()
 		ImGui::TextWrapped("# MCP agents: %d", mcpCount);
 		ImGui::TextWrapped("# UCC agents: %d", uccCount);
 		ImGui::TextWrapped("# UCP agents: %d", ucpCount);
+
+		// Changing the number of threads allows comparing the throughput
+		int threadCount = updateThreadCount();
+		if (ImGui::SliderInt("Update threads", &threadCount, 0, (int)std::thread::hardware_concurrency())) {
+			setUpdateThreadCount(threadCount);
+		}
+		ImGui::TextWrapped("Agents updated per second: %.0f", _agentsPerSecond);
+		ImGui::TextWrapped("State timeouts: %llu (%d timers scheduled)", (unsigned long long)_timeouts, (int)_timers.size());
+
+		const uint64_t batchesSent = _mccRegistrations.batchesSent();
+		const double registrationsPerBatch = (batchesSent > 0) ? (double)_mccRegistrations.registrationsSent() / batchesSent : 0.0;
+		ImGui::TextWrapped("MCC registration batches: %llu (%.1f MCCs per batch)", (unsigned long long)batchesSent, registrationsPerBatch);
 	}
 }
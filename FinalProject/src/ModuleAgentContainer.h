@@ -1,7 +1,13 @@
 #pragma once
 
 #include "Module.h"
+#include "AgentScheduler.h"
+#include "MCCRegistrationBatcher.h"
+#include "TimerWheel.h"
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 class Node;
@@ -25,16 +31,31 @@ public:
 	ModuleAgentContainer();
 	~ModuleAgentContainer();
 
-	// Agent creation methods
+	// Agent creation methods (nullptr if there are already MAX_AGENTS agents)
 	MCCPtr createMCC(Node *node, uint16_t contributedItemId, uint16_t constraintItemId);
 	MCPPtr createMCP(Node *node, uint16_t requestedItemId, uint16_t contributedItemId, unsigned int searchDepth);
-	UCCPtr createUCC(Node *node, uint16_t contributedItemId, uint16_t constraintItemId);
+	UCCPtr createUCC(Node *node, uint16_t contributedItemId, uint16_t constraintItemId, unsigned int searchDepth);
 	UCPPtr createUCP(Node *node, uint16_t requestedItemId, uint16_t contributedItemId, const AgentLocation &uccLocation, unsigned int searchDepth);
 
+	// Number of threads updating agents in parallel (0 to update them in order)
+	void setUpdateThreadCount(int threadCount);
+	int updateThreadCount() const { return _scheduler.threadCount(); }
+
 	// Getters
-	AgentPtr getAgent(int agentId);
+	AgentPtr getAgent(uint32_t agentId); // nullptr if it does not exist anymore
 	std::vector<AgentPtr> &allAgents() { return _agents; }
 	bool empty() const;
+	size_t peakAgentCount() const { return _peakAgentCount; } // Most agents alive at the same time
+	size_t freeAgentCount(); // Agents that can still be created
+
+	// Deadline of the current state of the agent (see Agent::setStateTimeout())
+	void scheduleTimeout(Agent *agent, unsigned int millis);
+
+	// MCC (un)registrations, sent to the YellowPages in batches once per frame
+	MCCRegistrationBatcher &mccRegistrations() { return _mccRegistrations; }
+
+	// Initialization
+	bool init() override;
 
 	// Update
 	bool update() override;
@@ -58,8 +79,47 @@ public:
 private:
 
 	// Setters
-	void addAgent(AgentPtr agent);
+	bool addAgent(AgentPtr agent);
+
+	// It updates the agents of each node as an independent task
+	void updateInParallel();
+
+	// It notifies the agents whose state deadline expired
+	void expireTimeouts();
+
+	// Agent identifiers
+	bool allocateId(Agent *agent);
+	void releaseId(Agent *agent);
 
 	std::vector<AgentPtr> _agentsToAdd; /**< Agents to add. */
+	std::mutex _agentsToAddMutex; /**< Agents can create other agents from several threads. */
 	std::vector<AgentPtr> _agents; /**< Array of agents. */
+
+	/** Entry of the agent lookup table (indexed by the low bits of the id). */
+	struct AgentSlot
+	{
+		AgentPtr agent; /**< Agent using the slot (null if free). */
+		uint16_t generation = 1; /**< High bits of the id of the current agent. */
+	};
+
+	std::vector<AgentSlot> _slots; /**< Agents by identifier. */
+	std::deque<uint16_t> _freeSlots; /**< Free slots, reused in FIFO order to delay id reuse. */
+
+	MCCRegistrationBatcher _mccRegistrations; /**< (Un)registrations of this frame. */
+
+	TimerWheel _timers; /**< Deadlines of the agent states. */
+	std::mutex _timersMutex; /**< Agents set deadlines from several threads. */
+	std::vector<TimerWheel::Timer> _expiredTimers; /**< Reused every frame. */
+	uint64_t _timeouts = 0; /**< Deadlines that expired. */
+
+	AgentScheduler _scheduler; /**< Worker threads updating agents. */
+	std::vector<std::vector<Agent*>> _nodeGroups; /**< Agents grouped by node (reused every frame). */
+
+	// Update throughput metrics
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point _metricsStart; /**< Start of the current measurement window. */
+	double _updateSeconds = 0.0; /**< Time spent updating agents in the window. */
+	uint64_t _updatedAgents = 0; /**< Agents updated in the window. */
+	double _agentsPerSecond = 0.0; /**< Throughput of the last window. */
+	size_t _peakAgentCount = 0; /**< Most agents alive at the end of a frame. */
 };
\ No newline at end of file
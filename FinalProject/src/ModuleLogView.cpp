@@ -11,6 +11,14 @@ bool ModuleLogView::init()
 
 bool ModuleLogView::updateGUI()
 {
+	{
+		std::lock_guard<std::mutex> lock(newMessagesMutex);
+		for (auto &message : newMessages) {
+			allMessages.push_back(std::move(message));
+		}
+		newMessages.clear();
+	}
+
 	ImGui::Begin("Log View");
 
 	if (ImGui::Button("Clear"))
@@ -52,7 +60,15 @@ bool ModuleLogView::updateGUI()
 	return true;
 }
 
+bool ModuleLogView::cleanUp()
+{
+	g_Log.removeOutput(this);
+
+	return true;
+}
+
 void ModuleLogView::writeMessage(const std::string & message)
 {
-	allMessages.push_back(message);
+	std::lock_guard<std::mutex> lock(newMessagesMutex);
+	newMessages.push_back(message);
 }
@@ -2,6 +2,7 @@
 
 #include "Module.h"
 #include "Log.h"
+#include <mutex>
 #include <vector>
 #include <string>
 
@@ -15,6 +16,8 @@ public:
 
 	bool updateGUI() override;
 
+	bool cleanUp() override;
+
 	// LogOutput virtual methods
 
 	void writeMessage(const std::string &message) override;
@@ -22,4 +25,7 @@ public:
 private:
 
 	std::vector<std::string> allMessages;
+
+	std::vector<std::string> newMessages; /**< Written by the logger thread, moved to allMessages by updateGUI(). */
+	std::mutex newMessagesMutex;
 };
\ No newline at end of file
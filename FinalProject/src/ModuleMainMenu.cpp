@@ -8,6 +8,7 @@
 #include "imgui/imgui.h"
 
 #include <d3d9.h>
+#include <algorithm>
 
 bool ModuleMainMenu::updateGUI()
 {
@@ -23,17 +24,46 @@ bool ModuleMainMenu::updateGUI()
 
 	if (ImGui::Button("Node cluster"))
 	{
+		g_Config.maxNodes = (unsigned int)_nodeCount;
+		g_Config.maxItems = (unsigned int)_itemCount;
+		g_Config.maxSearchDepth = (unsigned int)_searchDepth;
+
 		setEnabled(false);
 		App->agentContainer->setEnabled(true);
 		App->modNodeCluster->setEnabled(true);
 	}
 
+	// Size of the simulation (the defaults come from the command line)
+	ImGui::SameLine();
+	ImGui::PushItemWidth(80.0f);
+	ImGui::InputInt("Nodes", &_nodeCount);
+	ImGui::SameLine();
+	ImGui::InputInt("Items", &_itemCount);
+	ImGui::SameLine();
+	ImGui::InputInt("Depth", &_searchDepth);
+	ImGui::PopItemWidth();
+	_nodeCount = std::max(_nodeCount, 1);
+	_itemCount = std::min(std::max(_itemCount, 1), (int)MAX_CATALOGUE_ITEMS);
+	_searchDepth = std::max(_searchDepth, 0);
+
 	if (ImGui::Button("Yellow Pages"))
 	{
 		setEnabled(false);
+		App->modYellowPages->setClusterPosition(_ypPartition, _ypReplica);
 		App->modYellowPages->setEnabled(true);
 	}
 
+	// Several YellowPages processes can run in the same host
+	if (g_Config.ypPartitions * g_Config.ypReplicas > 1)
+	{
+		ImGui::SameLine();
+		ImGui::PushItemWidth(80.0f);
+		ImGui::SliderInt("Partition", &_ypPartition, 0, g_Config.ypPartitions - 1);
+		ImGui::SameLine();
+		ImGui::SliderInt("Replica", &_ypReplica, 0, g_Config.ypReplicas - 1);
+		ImGui::PopItemWidth();
+	}
+
 	ImGui::End();
 
 	return true;
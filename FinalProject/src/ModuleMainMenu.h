@@ -1,10 +1,20 @@
 #pragma once
 
 #include "Module.h"
+#include "Globals.h"
 
 class ModuleMainMenu : public Module
 {
 public:
 
 	bool updateGUI() override;
+
+private:
+
+	int _ypPartition = 0; /**< YellowPages partition to run. */
+	int _ypReplica = 0; /**< YellowPages replica to run. */
+
+	int _nodeCount = (int)g_Config.maxNodes; /**< Nodes of the cluster to run. */
+	int _itemCount = (int)g_Config.maxItems; /**< Items of the catalogue. */
+	int _searchDepth = (int)g_Config.maxSearchDepth; /**< Depth of the exchange search. */
 };
\ No newline at end of file
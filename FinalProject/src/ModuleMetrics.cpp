@@ -0,0 +1,118 @@
+#include "ModuleMetrics.h"
+#include "Globals.h"
+#include "Log.h"
+#include "imgui/imgui.h"
+#include <fstream>
+
+bool ModuleMetrics::start()
+{
+	_startTime = Clock::now();
+	_lastDumpTime = _startTime;
+
+	return true;
+}
+
+bool ModuleMetrics::update()
+{
+	// The window shows the metrics, so only headless runs or runs with
+	// a metrics file need the dumps
+	if (!g_Config.headless && g_Config.metricsPath.empty()) {
+		return true;
+	}
+
+	const Clock::time_point now = Clock::now();
+	if (now - _lastDumpTime >= std::chrono::milliseconds(METRICS_DUMP_INTERVAL_MILLIS)) {
+		_lastDumpTime = now;
+		dump();
+	}
+
+	return true;
+}
+
+bool ModuleMetrics::updateGUI()
+{
+	g_Metrics.snapshot(_snapshot);
+
+	ImGui::Begin("Metrics");
+
+	if (ImGui::CollapsingHeader("Counters", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Columns(2, "Counters");
+		for (auto &counter : _snapshot.counters)
+		{
+			if (counter.value == 0) {
+				continue;
+			}
+			ImGui::Text("%s", counter.name.c_str());
+			ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)counter.value);
+			ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+	}
+
+	if (ImGui::CollapsingHeader("Histograms", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Columns(5, "Histograms");
+		ImGui::Text("Name"); ImGui::NextColumn();
+		ImGui::Text("Count"); ImGui::NextColumn();
+		ImGui::Text("p50"); ImGui::NextColumn();
+		ImGui::Text("p99"); ImGui::NextColumn();
+		ImGui::Text("Max"); ImGui::NextColumn();
+		ImGui::Separator();
+		for (auto &histogram : _snapshot.histograms)
+		{
+			if (histogram.count == 0) {
+				continue;
+			}
+			ImGui::Text("%s", histogram.name.c_str()); ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)histogram.count); ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)histogram.p50); ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)histogram.p99); ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)histogram.max); ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+	}
+
+	ImGui::End();
+
+	return true;
+}
+
+bool ModuleMetrics::stop()
+{
+	// Last values of the run
+	if (g_Config.headless || !g_Config.metricsPath.empty()) {
+		dump();
+	}
+
+	return true;
+}
+
+void ModuleMetrics::dump()
+{
+	Metrics::Snapshot snapshot;
+	g_Metrics.snapshot(snapshot);
+
+	const double seconds = std::chrono::duration<double>(Clock::now() - _startTime).count();
+
+	if (g_Config.headless)
+	{
+		std::vector<std::string> lines;
+		Metrics::toText(snapshot, lines);
+		iLog << "Metrics at " << seconds << " s:";
+		for (auto &line : lines) {
+			iLog << " - " << line;
+		}
+	}
+
+	if (!g_Config.metricsPath.empty())
+	{
+		std::ofstream file(g_Config.metricsPath.c_str(), std::ios::out | std::ios::app);
+		if (file.is_open()) {
+			file << "{\"seconds\":" << seconds << ",\"metrics\":" << Metrics::toJSON(snapshot) << "}" << std::endl;
+		} else {
+			eLog << "Could not write the metrics file " << g_Config.metricsPath;
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Module.h"
+#include "Metrics.h"
+#include <chrono>
+
+/**
+ * It shows the metrics of g_Metrics (see Metrics.h) in a window and,
+ * in headless runs, dumps them every METRICS_DUMP_INTERVAL_MILLIS
+ * into the log. With the option --metrics <file>, each dump is also
+ * appended to the file as a JSON line.
+ */
+class ModuleMetrics : public Module
+{
+public:
+
+	// Virtual methods from parent class Module
+
+	bool start() override;
+
+	bool update() override;
+
+	bool updateGUI() override;
+
+	bool stop() override;
+
+private:
+
+	// It writes the current metrics to the log and/or the metrics file
+	void dump();
+
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point _startTime; /**< Time the module was enabled. */
+	Clock::time_point _lastDumpTime; /**< Time of the last dump. */
+
+	Metrics::Snapshot _snapshot; /**< Metrics shown in the window (reused each frame). */
+};
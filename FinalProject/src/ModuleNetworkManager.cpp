@@ -1,13 +1,22 @@
 #pragma once
 
 #include "ModuleNetworkManager.h"
+#include "Globals.h"
+#include "YellowPagesCluster.h"
+#include "Log.h"
+#include "Metrics.h"
 #include "imgui/imgui.h"
+#include <algorithm>
 
 
 bool ModuleNetworkManager::init()
 {
 	SocketUtil::StaticInit();
 
+	SetConnectTimeout(CONNECT_TIMEOUT_MILLIS);
+	SetMaxPacketSize(MAX_PACKET_SIZE);
+	SetIOThreadCount(NETWORK_IO_THREADS);
+
 	return true;
 }
 
@@ -18,8 +27,21 @@ bool ModuleNetworkManager::preUpdate()
 
 bool ModuleNetworkManager::postUpdate()
 {
-	const int timeoutMillis = 0;
-	HandleSocketOperations(timeoutMillis);
+	static const Metrics::Id loopbackDeliveryTime = g_Metrics.histogram("net.loopback_delivery_us");
+	static const Metrics::Id socketOperationsTime = g_Metrics.histogram("net.socket_operations_us");
+
+	{
+		ScopedTimer timer(loopbackDeliveryTime);
+		deliverLoopbackPackets();
+	}
+
+	{
+		ScopedTimer timer(socketOperationsTime);
+		const int timeoutMillis = 0;
+		HandleSocketOperations(timeoutMillis);
+	}
+
+	evictIdleConnections();
 
 	return true;
 }
@@ -28,16 +50,333 @@ bool ModuleNetworkManager::stop()
 {
 	Finalize();
 
+	for (auto &pair : _peers) {
+		accumulateMetrics(pair.second);
+		pair.second.socket = nullptr;
+	}
+
 	return true;
 }
 
 bool ModuleNetworkManager::cleanUp()
 {
+	_peers.clear();
+	setLoopbackPort(0);
+
 	SocketUtil::CleanUp();
 
 	return true;
 }
 
+TCPSocketPtr ModuleNetworkManager::getConnection(const std::string &host, uint16_t port)
+{
+	PeerConnection &peer = _peers[PeerKey(host, port)];
+
+	// Reuse the current connection if it is still alive
+	if (peer.socket != nullptr)
+	{
+		if (!peer.socket->IsDisconnected() && !peer.socket->ToDisconnect()) {
+			return peer.socket;
+		}
+		accumulateMetrics(peer);
+		peer.socket = nullptr;
+	}
+
+	// Create socket
+	TCPSocketPtr socket = SocketUtil::CreateTCPSocket(SocketAddressFamily::INET);
+	if (socket == nullptr) {
+		eLog << "SocketUtil::CreateTCPSocket() failed";
+		return nullptr;
+	}
+
+	// Connect to the peer without blocking
+	// Packets sent meanwhile are queued until the connection completes
+	char addressAndPort[128];
+	sprintf_s(addressAndPort, "%s:%d", host.c_str(), port);
+	SocketAddress address(addressAndPort);
+	int res = socket->ConnectAsync(address);
+	if (res != NO_ERROR) {
+		eLog << "TCPSocket::ConnectAsync() failed";
+		peer.connectFailures++;
+		peer.retryTime = Clock::now() + std::chrono::milliseconds(YP_REPLICA_RETRY_MILLIS);
+		return nullptr;
+	}
+
+	// Add socket to the network manager
+	AddSocket(socket);
+
+	peer.socket = socket;
+	peer.pinned = false;
+	peer.lastUsed = Clock::now();
+	peer.lastPacketCount = 0;
+	peer.connections++;
+	return socket;
+}
+
+bool ModuleNetworkManager::sendPacket(const std::string &host, uint16_t port, OutputMemoryStream &stream)
+{
+	std::lock_guard<std::mutex> lock(_sendMutex);
+
+	if (isLoopback(host, port)) {
+		queueLoopbackPacket(stream);
+		return true;
+	}
+
+	TCPSocketPtr socket = getConnection(host, port);
+	if (socket == nullptr) {
+		return false;
+	}
+
+	sendThroughSocket(socket, stream);
+	return true;
+}
+
+bool ModuleNetworkManager::sendPacket(TCPSocketPtr socket, OutputMemoryStream &stream)
+{
+	std::lock_guard<std::mutex> lock(_sendMutex);
+
+	if (socket->IsLoopback()) {
+		queueLoopbackPacket(stream);
+		return true;
+	}
+
+	sendThroughSocket(socket, stream);
+	return true;
+}
+
+void ModuleNetworkManager::setConnectionPinned(TCPSocketPtr socket, bool pinned)
+{
+	std::lock_guard<std::mutex> lock(_sendMutex);
+
+	for (auto &pair : _peers) {
+		if (pair.second.socket == socket) {
+			pair.second.pinned = pinned;
+		}
+	}
+}
+
+TCPSocketPtr ModuleNetworkManager::getYellowPagesConnection(uint16_t itemId)
+{
+	std::lock_guard<std::mutex> lock(_sendMutex);
+
+	const int partition = yellowPagesPartition(itemId);
+	return getConnection(HOSTNAME_YP, reachableYellowPagesPort(partition));
+}
+
+bool ModuleNetworkManager::sendPacketToYellowPages(uint16_t itemId, OutputMemoryStream &stream, bool allReplicas)
+{
+	std::lock_guard<std::mutex> lock(_sendMutex);
+
+	const int partition = yellowPagesPartition(itemId);
+	if (!allReplicas)
+	{
+		TCPSocketPtr socket = getConnection(HOSTNAME_YP, reachableYellowPagesPort(partition));
+		if (socket == nullptr) {
+			return false;
+		}
+		sendThroughSocket(socket, stream);
+		return true;
+	}
+
+	// It succeeds if at least one replica got the packet
+	bool sent = false;
+	for (int replica = 0; replica < g_Config.ypReplicas; ++replica)
+	{
+		TCPSocketPtr socket = getConnection(HOSTNAME_YP, yellowPagesPort(partition, replica));
+		if (socket != nullptr) {
+			sendThroughSocket(socket, stream);
+			sent = true;
+		}
+	}
+	return sent;
+}
+
+uint16_t ModuleNetworkManager::reachableYellowPagesPort(int partition)
+{
+	// Replicas are tried in order, so all the queries of a partition go to
+	// the same replica while it works
+	const Clock::time_point now = Clock::now();
+	for (int replica = 0; replica < g_Config.ypReplicas; ++replica)
+	{
+		const uint16_t port = yellowPagesPort(partition, replica);
+		auto it = _peers.find(PeerKey(HOSTNAME_YP, port));
+		if (it == _peers.end() || now >= it->second.retryTime) {
+			return port;
+		}
+	}
+
+	// All of them are failing, keep trying the first one
+	return yellowPagesPort(partition, 0);
+}
+
+void ModuleNetworkManager::evictIdleConnections()
+{
+	const Clock::time_point now = Clock::now();
+	const auto idleTimeout = std::chrono::milliseconds(POOL_IDLE_TIMEOUT_MILLIS);
+
+	for (auto &pair : _peers)
+	{
+		PeerConnection &peer = pair.second;
+		if (peer.socket == nullptr) {
+			continue;
+		}
+
+		// Release broken connections
+		if (peer.socket->IsDisconnected()) {
+			if (peer.socket->ConnectFailed()) {
+				peer.connectFailures++;
+				peer.retryTime = now + std::chrono::milliseconds(YP_REPLICA_RETRY_MILLIS);
+			}
+			accumulateMetrics(peer);
+			peer.socket = nullptr;
+			continue;
+		}
+
+		// Sent and received packets keep the connection alive
+		const uint64_t packetCount = peer.socket->PacketsSent() + peer.socket->PacketsReceived();
+		if (packetCount != peer.lastPacketCount) {
+			peer.lastPacketCount = packetCount;
+			peer.lastUsed = now;
+		}
+		else if (now - peer.lastUsed > idleTimeout && !peer.socket->HasOutgoingData() && !peer.pinned) {
+			peer.socket->Disconnect();
+			accumulateMetrics(peer);
+			peer.socket = nullptr;
+			peer.evictions++;
+		}
+	}
+}
+
+void ModuleNetworkManager::setLoopbackPort(uint16_t port)
+{
+	std::lock_guard<std::mutex> lock(_sendMutex);
+
+	_loopbackPort = ENABLE_LOOPBACK_TRANSPORT ? port : 0;
+	_loopbackSocket = nullptr;
+	_loopbackPackets.clear();
+
+	// The agents see the packets as coming from a connection to localhost
+	if (_loopbackPort != 0) {
+		_loopbackSocket = SocketUtil::CreateLoopbackSocket(SocketAddress(INADDR_LOOPBACK, _loopbackPort));
+	}
+}
+
+bool ModuleNetworkManager::isLoopback(const std::string &host, uint16_t port) const
+{
+	if (_loopbackPort == 0 || port != _loopbackPort) {
+		return false;
+	}
+	return host == "localhost" || host.compare(0, 4, "127.") == 0;
+}
+
+void ModuleNetworkManager::queueLoopbackPacket(OutputMemoryStream &stream)
+{
+	const uint32_t size = stream.GetSize();
+	const char *sizeBytes = reinterpret_cast<const char*>(&size);
+	_loopbackPackets.insert(_loopbackPackets.end(), sizeBytes, sizeBytes + sizeof(size));
+	_loopbackPackets.insert(_loopbackPackets.end(), stream.GetBufferPtr(), stream.GetBufferPtr() + size);
+
+	_loopbackPacketsSent++;
+	_loopbackBytesSent += size;
+	countSentPacket(stream);
+}
+
+void ModuleNetworkManager::deliverLoopbackPackets()
+{
+	TCPSocketPtr socket;
+	{
+		std::lock_guard<std::mutex> lock(_sendMutex);
+		_loopbackDelivery.swap(_loopbackPackets);
+		socket = _loopbackSocket;
+	}
+
+	// Packets sent while delivering (e.g. replies) wait for the next frame,
+	// as they would in a socket
+	TCPNetworkManagerDelegate *delegate = GetDelegate();
+	size_t offset = 0;
+	while (offset < _loopbackDelivery.size() && delegate != nullptr && socket != nullptr)
+	{
+		uint32_t size;
+		memcpy(&size, _loopbackDelivery.data() + offset, sizeof(size));
+		offset += sizeof(size);
+
+		InputMemoryStream stream(_loopbackDelivery.data() + offset, size);
+		delegate->OnPacketReceived(socket, stream);
+		offset += size;
+	}
+	_loopbackDelivery.clear();
+}
+
+void ModuleNetworkManager::socketTraffic(uint64_t &packets, uint64_t &bytes)
+{
+	std::lock_guard<std::mutex> lock(_sendMutex);
+	packets = _socketPacketsSent;
+	bytes = _socketBytesSent;
+}
+
+void ModuleNetworkManager::loopbackTraffic(uint64_t &packets, uint64_t &bytes)
+{
+	std::lock_guard<std::mutex> lock(_sendMutex);
+	packets = _loopbackPacketsSent;
+	bytes = _loopbackBytesSent;
+}
+
+void ModuleNetworkManager::sendThroughSocket(TCPSocketPtr socket, OutputMemoryStream &stream)
+{
+	socket->SendPacket(stream.GetBufferPtr(), stream.GetSize());
+
+	_socketPacketsSent++;
+	_socketBytesSent += stream.GetSize();
+	countSentPacket(stream);
+}
+
+void ModuleNetworkManager::countPacket(PacketType packetType, uint32_t size, bool sent)
+{
+	// Counter ids by packet type: packets and bytes, sent and received
+	struct PacketCounters
+	{
+		Metrics::Id ids[(size_t)PacketType::Last + 1][4];
+		PacketCounters()
+		{
+			for (size_t type = 0; type <= (size_t)PacketType::Last; ++type)
+			{
+				const std::string name = packetTypeName((PacketType)type);
+				ids[type][0] = g_Metrics.counter("packets.sent." + name);
+				ids[type][1] = g_Metrics.counter("bytes.sent." + name);
+				ids[type][2] = g_Metrics.counter("packets.received." + name);
+				ids[type][3] = g_Metrics.counter("bytes.received." + name);
+			}
+		}
+	};
+	static const PacketCounters counters;
+
+	const size_t type = std::min((size_t)packetType, (size_t)PacketType::Last);
+	const Metrics::Id *ids = counters.ids[type] + (sent ? 0 : 2);
+	g_Metrics.add(ids[0]);
+	g_Metrics.add(ids[1], size);
+}
+
+void ModuleNetworkManager::countSentPacket(const OutputMemoryStream &stream)
+{
+	// Every packet starts with its PacketHeader
+	PacketType packetType = PacketType::Last;
+	if (stream.GetSize() >= sizeof(packetType)) {
+		memcpy(&packetType, stream.GetBufferPtr(), sizeof(packetType));
+	}
+	countPacket(packetType, stream.GetSize(), true);
+}
+
+void ModuleNetworkManager::accumulateMetrics(PeerConnection &peer)
+{
+	if (peer.socket != nullptr)
+	{
+		peer.packetsSent += peer.socket->PacketsSent();
+		peer.bytesSent += peer.socket->BytesSent();
+		peer.packetsReceived += peer.socket->PacketsReceived();
+		peer.bytesReceived += peer.socket->BytesReceived();
+	}
+}
+
 void ModuleNetworkManager::drawInfoGUI()
 {
 	if (ImGui::CollapsingHeader("ModuleNetworkManager", ImGuiTreeNodeFlags_DefaultOpen))
@@ -45,5 +384,37 @@ void ModuleNetworkManager::drawInfoGUI()
 		int socketsCount = (int)TCPNetworkManager::allSockets().size();
 
 		ImGui::TextWrapped("# active sockets: %d", socketsCount);
+		ImGui::TextWrapped("Poller backend: %s", GetPollerName());
+		ImGui::TextWrapped("I/O threads: %d", GetIOThreadCount());
+		ImGui::TextWrapped("Loopback packets: %llu (%llu bytes)", (unsigned long long)_loopbackPacketsSent, (unsigned long long)_loopbackBytesSent);
+
+		if (ImGui::TreeNode("Connection pool"))
+		{
+			for (auto &pair : _peers)
+			{
+				const PeerConnection &peer = pair.second;
+
+				// Include the traffic of the current connection
+				uint64_t packetsSent = peer.packetsSent, bytesSent = peer.bytesSent;
+				uint64_t packetsReceived = peer.packetsReceived, bytesReceived = peer.bytesReceived;
+				if (peer.socket != nullptr) {
+					packetsSent += peer.socket->PacketsSent();
+					bytesSent += peer.socket->BytesSent();
+					packetsReceived += peer.socket->PacketsReceived();
+					bytesReceived += peer.socket->BytesReceived();
+				}
+
+				const char *status = "idle";
+				if (peer.socket != nullptr) {
+					status = peer.socket->IsConnecting() ? "connecting" : "connected";
+				}
+
+				ImGui::Text("%s:%d (%s)", pair.first.first.c_str(), (int)pair.first.second, status);
+				ImGui::Text(" - connections: %u, failures: %u, evictions: %u", peer.connections, peer.connectFailures, peer.evictions);
+				ImGui::Text(" - sent: %llu packets (%llu bytes)", (unsigned long long)packetsSent, (unsigned long long)bytesSent);
+				ImGui::Text(" - received: %llu packets (%llu bytes)", (unsigned long long)packetsReceived, (unsigned long long)bytesReceived);
+			}
+			ImGui::TreePop();
+		}
 	}
 }
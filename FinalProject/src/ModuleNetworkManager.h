@@ -1,7 +1,11 @@
 #pragma once
 
 #include "Module.h"
+#include "Packets.h"
 #include "net/Net.h"
+#include <chrono>
+#include <map>
+#include <mutex>
 
 class ModuleNetworkManager : public Module, public TCPNetworkManager
 {
@@ -19,7 +23,115 @@ public:
 
 	bool cleanUp() override;
 
+
+	// Connection pool
+
+	// It returns the pooled connection to the given peer (connecting if needed)
+	TCPSocketPtr getConnection(const std::string &host, uint16_t port);
+
+	// It sends a packet through the pooled connection to the given peer
+	bool sendPacket(const std::string &host, uint16_t port, OutputMemoryStream &stream);
+
+	// It sends a packet through an existing connection
+	bool sendPacket(TCPSocketPtr socket, OutputMemoryStream &stream);
+
+	// Pinned connections are never evicted for being idle (e.g. they hold
+	// YellowPages subscriptions that are lost if they close)
+	void setConnectionPinned(TCPSocketPtr socket, bool pinned);
+
+
+	// YellowPages cluster (see YellowPagesCluster.h)
+
+	// It returns the pooled connection to the first reachable replica of the partition of the item
+	TCPSocketPtr getYellowPagesConnection(uint16_t itemId);
+
+	// It sends a packet to the partition of the item, either to all its replicas
+	// (changes of the YellowPages) or only to the first reachable one (queries)
+	bool sendPacketToYellowPages(uint16_t itemId, OutputMemoryStream &stream, bool allReplicas);
+
+
+	// Loopback transport (see ENABLE_LOOPBACK_TRANSPORT)
+
+	// Port where the agents of this process listen (0 if there are none)
+	void setLoopbackPort(uint16_t port);
+
+
+	// Traffic statistics
+
+	// Packets and payload bytes sent by this process through sockets
+	void socketTraffic(uint64_t &packets, uint64_t &bytes);
+
+	// Packets and payload bytes delivered in memory by this process
+	void loopbackTraffic(uint64_t &packets, uint64_t &bytes);
+
+	// It counts a packet of the given type in the metrics (see Metrics.h)
+	static void countPacket(PacketType packetType, uint32_t size, bool sent);
+
 public:
 
 	void drawInfoGUI();
+
+private:
+
+	using Clock = std::chrono::steady_clock;
+	using PeerKey = std::pair<std::string, uint16_t>;
+
+	/**
+	 * Long-lived connection shared by all the agents talking to a peer.
+	 * Packets of different agents are told apart by their PacketHeader.
+	 */
+	struct PeerConnection
+	{
+		TCPSocketPtr socket; /**< Current connection (null if evicted). */
+		Clock::time_point lastUsed; /**< Last time a packet was sent or received. */
+		uint64_t lastPacketCount = 0; /**< Packets seen at the last idle check. */
+		Clock::time_point retryTime; /**< After a failed connection, it is skipped until then (YellowPages replicas). */
+		bool pinned = false; /**< Whether the current connection is kept while idle. */
+
+		// Metrics (accumulated over all the connections to this peer)
+		unsigned int connections = 0;
+		unsigned int connectFailures = 0;
+		unsigned int evictions = 0;
+		uint64_t packetsSent = 0;
+		uint64_t bytesSent = 0;
+		uint64_t packetsReceived = 0;
+		uint64_t bytesReceived = 0;
+	};
+
+	// It closes the connections that were not used for a while
+	void evictIdleConnections();
+
+	// It returns the port of the first replica of the partition that is not failing
+	uint16_t reachableYellowPagesPort(int partition);
+
+	// It moves the traffic statistics of the current socket into the peer metrics
+	void accumulateMetrics(PeerConnection &peer);
+
+	// It sends the packet and counts it (with _sendMutex locked)
+	void sendThroughSocket(TCPSocketPtr socket, OutputMemoryStream &stream);
+
+	// It counts an outgoing packet by the type in its header
+	static void countSentPacket(const OutputMemoryStream &stream);
+
+	// Whether the peer is this process (packets to it skip the sockets)
+	bool isLoopback(const std::string &host, uint16_t port) const;
+
+	// It queues the packet for the next postUpdate() (with _sendMutex locked)
+	void queueLoopbackPacket(OutputMemoryStream &stream);
+
+	// It delivers the queued packets to the delegate, as if they were received
+	void deliverLoopbackPackets();
+
+	std::map<PeerKey, PeerConnection> _peers; /**< Pooled connections by (host, port). */
+
+	std::mutex _sendMutex; /**< Agents can send packets from several threads. */
+
+	uint16_t _loopbackPort = 0; /**< Listen port of the agents of this process. */
+	TCPSocketPtr _loopbackSocket; /**< Connection the loopback packets come from (replies go back through it). */
+	std::vector<char> _loopbackPackets; /**< Queued packets, each one preceded by its size. */
+	std::vector<char> _loopbackDelivery; /**< Packets being delivered (swapped with the queue). */
+	uint64_t _socketPacketsSent = 0;
+	uint64_t _socketBytesSent = 0;
+	uint64_t _loopbackPacketsSent = 0;
+	uint64_t _loopbackBytesSent = 0;
 };
@@ -5,8 +5,13 @@
 #include "Log.h"
 #include "Packets.h"
 #include "imgui/imgui.h"
+#include <random>
 #include <sstream>
 
+// Largest cluster shown in the nodes/items matrix
+static const unsigned int MATRIX_MAX_ITEMS = 64U;
+static const unsigned int MATRIX_MAX_NODES = 64U;
+
 enum State {
 	STOPPED,
 	STARTING,
@@ -68,6 +73,14 @@ bool ModuleNodeCluster::updateGUI()
 
 		ImGui::CollapsingHeader("ModuleNodeCluster", ImGuiTreeNodeFlags_DefaultOpen);
 
+		// Both searches can run at the same time, so their rates can be compared
+		ImGui::Checkbox("Centralized exchange solver", &_solverEnabled);
+		ImGui::TextWrapped("Exchanges per second (agents): %.1f", _agentExchangesPerSecond);
+		ImGui::TextWrapped("Exchanges per second (solver): %.1f", _solverExchangesPerSecond);
+		ImGui::TextWrapped("Solver time: %.3f ms per run", _solverMillisPerRun);
+		ImGui::TextWrapped("Sub-searches pruned by the cache: %llu of %llu",
+			(unsigned long long)_searchCache.hits(), (unsigned long long)_searchCache.lookups());
+
 		int itemsCount = 0;
 		for (auto node : _nodes) {
 			itemsCount += (int)node->itemList().numItems();
@@ -84,27 +97,7 @@ bool ModuleNodeCluster::updateGUI()
 
 		if (ImGui::Button("Create random MCCs"))
 		{
-			for (NodePtr node : _nodes)
-			{
-				for (ItemId contributedItem = 0; contributedItem < MAX_ITEMS; ++contributedItem)
-				{
-					if (node->itemList().numItemsWithId(contributedItem) > 1)
-					{
-						unsigned int numItemsToContribute = node->itemList().numItemsWithId(contributedItem) -  1;
-
-						for (ItemId constraintItem = 0; constraintItem < MAX_ITEMS; ++constraintItem)
-						{
-							if (node->itemList().numItemsWithId(constraintItem) == 0)
-							{
-								for (unsigned int i = 0; i < numItemsToContribute; ++i)
-								{
-									spawnMCC(node->id(), contributedItem, constraintItem);
-								}
-							}
-						}
-					}
-				}
-			}
+			spawnMCCs();
 		}
 
 		if (ImGui::Button("Clear all agents"))
@@ -131,18 +124,18 @@ bool ModuleNodeCluster::updateGUI()
 				{
 					auto &itemList = node->itemList();
 
-					for (int itemId = 0; itemId < MAX_ITEMS; ++itemId)
+					itemList.presentItems().forEach([&](ItemId itemId)
 					{
 						unsigned int numItems = itemList.numItemsWithId(itemId);
 						if (numItems == 1)
 						{
-							ImGui::Text("Item %d", itemId);
+							ImGui::Text("Item %u", itemId);
 						}
-						else if (numItems > 1)
+						else
 						{
-							ImGui::Text("Item %d (x%d)", itemId, numItems);
+							ImGui::Text("Item %u (x%u)", itemId, numItems);
 						}
-					}
+					});
 
 					ImGui::TreePop();
 				}
@@ -183,7 +176,10 @@ bool ModuleNodeCluster::updateGUI()
 
 	ImGui::End();
 
-	if (state == RUNNING)
+	// With large catalogues the matrix would have a button per node and item
+	const bool showMatrix = g_Config.maxItems <= MATRIX_MAX_ITEMS && _nodes.size() <= MATRIX_MAX_NODES;
+
+	if (state == RUNNING && showMatrix)
 	{
 		// NODES / ITEMS MATRIX /////////////////////////////////////////////////////////
 
@@ -197,13 +193,13 @@ bool ModuleNodeCluster::updateGUI()
 		ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.3f, 0.6f, 1.0f, 0.5f));
 		ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.3f, 0.6f, 1.0f, 0.5f));
 		ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.3f, 0.6f, 1.0f, 0.5f));
-		for (ItemId itemId = 0U; itemId < MAX_ITEMS; ++itemId)
+		for (ItemId itemId = 0U; itemId < g_Config.maxItems; ++itemId)
 		{
 			ImGui::SameLine();
 			std::ostringstream oss;
 			oss << itemId;
 			ImGui::Button(oss.str().c_str(), ImVec2(20, 20));
-			if (itemId < MAX_ITEMS - 1) ImGui::SameLine();
+			if (itemId < g_Config.maxItems - 1) ImGui::SameLine();
 		}
 		ImGui::PopStyleColor(3);
 
@@ -214,7 +210,7 @@ bool ModuleNodeCluster::updateGUI()
 			ImGui::Text("Node %02u ", nodeIndex);
 			ImGui::SameLine();
 
-			for (ItemId itemId = 0U; itemId < MAX_ITEMS; ++itemId)
+			for (ItemId itemId = 0U; itemId < g_Config.maxItems; ++itemId)
 			{
 				unsigned int numItems = _nodes[nodeIndex]->itemList().numItemsWithId(itemId);
 
@@ -231,7 +227,7 @@ bool ModuleNodeCluster::updateGUI()
 					ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(.0f, 1.0f, 0.0f, 0.2f*numItems));
 				}
 
-				const int buttonId = nodeIndex * MAX_ITEMS + itemId;
+				const int buttonId = nodeIndex * g_Config.maxItems + itemId;
 				std::ostringstream oss;
 				oss << numItems;
 				oss << "##" << buttonId;
@@ -249,7 +245,7 @@ bool ModuleNodeCluster::updateGUI()
 
 				ImGui::PopStyleColor(3);
 
-				if (itemId < MAX_ITEMS - 1) ImGui::SameLine();
+				if (itemId < g_Config.maxItems - 1) ImGui::SameLine();
 			}
 		}
 
@@ -266,15 +262,14 @@ bool ModuleNodeCluster::updateGUI()
 				// Check if we have spare items
 				std::vector<std::string> comboStrings;
 				std::vector<int> itemIds;
-				for (ItemId itemId = 0; itemId < MAX_ITEMS; ++itemId) {
-					if (_nodes[selectedNode]->itemList().numItemsWithId(itemId) > 1)
-					{
-						std::ostringstream oss;
-						oss << itemId;
-						comboStrings.push_back(oss.str());
-						itemIds.push_back(itemId);
-					}
-				}
+				const ItemSet spareItems = _nodes[selectedNode]->itemList().spareItems();
+				spareItems.forEach([&](ItemId itemId)
+				{
+					std::ostringstream oss;
+					oss << itemId;
+					comboStrings.push_back(oss.str());
+					itemIds.push_back(itemId);
+				});
 
 				std::vector<const char *> comboCStrings;
 				for (auto &s : comboStrings) { comboCStrings.push_back(s.c_str()); }
@@ -333,12 +328,39 @@ void ModuleNodeCluster::OnPacketReceived(TCPSocketPtr socket, InputMemoryStream
 
 	PacketHeader packetHead;
 	packetHead.Read(stream);
+	ModuleNetworkManager::countPacket(packetHead.packetType, stream.GetCapacity(), false);
+
+	// Subscription updates from the YellowPages are not for agents
+	if (packetHead.dstAgentId == NULL_AGENT_ID && _mccDirectory.handlePacket(socket, packetHead, stream))
+	{
+		return;
+	}
+
+	// Acks of batched registrations are split among the MCCs
+	if (packetHead.packetType == PacketType::RegisterMCCBatchAck)
+	{
+		PacketRegisterMCCBatchAck packetData;
+		packetData.Read(stream);
+
+		PacketHeader ackHead;
+		ackHead.packetType = PacketType::RegisterMCCAck;
+		InputMemoryStream emptyStream(nullptr, 0);
+		for (auto agentId : packetData.agentIds)
+		{
+			auto agentPtr = App->agentContainer->getAgent(agentId);
+			if (agentPtr != nullptr) {
+				ackHead.dstAgentId = agentId;
+				agentPtr->postPacket(socket, ackHead, emptyStream);
+			}
+		}
+		return;
+	}
 
 	// Get the agent
 	auto agentPtr = App->agentContainer->getAgent(packetHead.dstAgentId);
 	if (agentPtr != nullptr)
 	{
-		agentPtr->OnPacketReceived(socket, packetHead, stream);
+		agentPtr->postPacket(socket, packetHead, stream);
 	}
 	else
 	{
@@ -348,7 +370,13 @@ void ModuleNodeCluster::OnPacketReceived(TCPSocketPtr socket, InputMemoryStream
 
 void ModuleNodeCluster::OnDisconnected(TCPSocketPtr socket)
 {
-	// Nothing to do
+	_mccDirectory.handleDisconnection(socket);
+}
+
+void ModuleNodeCluster::OnConnectFailed(TCPSocketPtr socket)
+{
+	// Packets queued in this connection are lost
+	wLog << "Could not connect to " << socket->RemoteAddress().GetString();
 }
 
 bool ModuleNodeCluster::startSystem()
@@ -383,9 +411,19 @@ bool ModuleNodeCluster::startSystem()
 	App->networkManager->SetDelegate(this);
 	App->networkManager->AddSocket(listenSocket);
 
+	// Packets among the agents of this process do not need the sockets
+	App->networkManager->setLoopbackPort(LISTEN_PORT_AGENTS);
+
+	_metricsStart = Clock::now();
+	_totalAgentExchanges = 0;
+	_totalSolverExchanges = 0;
+	_negotiationLatencies.clear();
+
 #ifdef RANDOM_INITIALIZATION
 	// Initialize nodes
-	for (int i = 0; i < MAX_NODES; ++i)
+	const unsigned int nodeCount = g_Config.maxNodes;
+	const unsigned int itemCount = g_Config.maxItems;
+	for (unsigned int i = 0; i < nodeCount; ++i)
 	{
 		// Create and intialize nodes
 		NodePtr node = std::make_shared<Node>(i);
@@ -393,17 +431,19 @@ bool ModuleNodeCluster::startSystem()
 		_nodes.push_back(node);
 	}
 
-	// Randomize
-	for (int j = 0; j < MAX_ITEMS; ++j)
+	// Randomize (rand() only reaches 32767 on some platforms)
+	std::mt19937 random(g_Config.randomSeed != 0 ? g_Config.randomSeed : std::random_device{}());
+	std::uniform_int_distribution<ItemId> randomItem(0, itemCount - 1);
+	for (unsigned int j = 0; j < itemCount; ++j)
 	{
-		for (int i = 0; i < MAX_NODES; ++i)
+		for (unsigned int i = 0; i < nodeCount; ++i)
 		{
-			ItemId itemId = rand() % MAX_ITEMS;
+			ItemId itemId = randomItem(random);
 			while (_nodes[i]->itemList().numItemsWithId(itemId) == 0) {
-				itemId = rand() % MAX_ITEMS;
+				itemId = randomItem(random);
 			}
 			_nodes[i]->itemList().removeItem(itemId);
-			_nodes[(i + 1) % MAX_NODES]->itemList().addItem(itemId);
+			_nodes[(i + 1) % nodeCount]->itemList().addItem(itemId);
 		}
 	}
 #else
@@ -438,6 +478,11 @@ bool ModuleNodeCluster::startSystem()
 
 void ModuleNodeCluster::runSystem()
 {
+	// Exchanges found by the solver are applied below, as the ones found by agents
+	if (_solverEnabled) {
+		runSolver();
+	}
+
 	// Check the results of agents
 	for (AgentPtr agent : App->agentContainer->allAgents())
 	{
@@ -461,9 +506,14 @@ void ModuleNodeCluster::runSystem()
 		if (mcp != nullptr && mcp->negotiationFinished() && mcp->searchDepth() == 0)
 		{
 			Node *node = mcp->node();
+			_negotiationLatencies.push_back(mcp->ageMillis());
 
 			if (mcp->negotiationAgreement())
 			{
+				if (!mcp->exchangeCommitted()) {
+					_agentExchanges++;
+					_totalAgentExchanges++;
+				}
 				node->itemList().addItem(mcp->requestedItemId());
 				node->itemList().removeItem(mcp->contributedItemId());
 				iLog << "MCP exchange at Node " << node->id() << ":"
@@ -491,17 +541,146 @@ void ModuleNodeCluster::runSystem()
 		MCC *mcc = agent->asMCC();
 		if (mcc != nullptr && mcc->isIdling())
 		{
-			int numContributedItems = node->itemList().numItemsWithId(mcc->contributedItemId());
-			int numRequestedItems = node->itemList().numItemsWithId(mcc->constraintItemId());
-			if (numContributedItems < 2 || numRequestedItems > 0) { // if the contributed is not repeated at least once... or we already got the constraint
+			const ItemList &itemList = node->itemList();
+			if (!itemList.spareItems().test(mcc->contributedItemId()) || itemList.presentItems().test(mcc->constraintItemId())) { // if the contributed is not repeated at least once... or we already got the constraint
 				mcc->stop();
 			}
 		}
 	}
+
+	// Subscribe to the items searched by new MCPs
+	_mccDirectory.sendSubscriptions();
+
+	updateExchangeMetrics();
+}
+
+void ModuleNodeCluster::runSolver()
+{
+	const Clock::time_point solverStart = Clock::now();
+
+	// Petitions of the users first (they have priority), then the MCCs
+	_offers.clear();
+	for (AgentPtr agent : App->agentContainer->allAgents())
+	{
+		MCP *mcp = agent->asMCP();
+		if (agent->isValid() && mcp != nullptr && mcp->searchDepth() == 0 && mcp->isWaitingForMCCs()) {
+			_offers.push_back({ mcp, mcp->node(), mcp->contributedItemId(), mcp->requestedItemId() });
+		}
+	}
+	for (AgentPtr agent : App->agentContainer->allAgents())
+	{
+		MCC *mcc = agent->asMCC();
+		if (agent->isValid() && mcc != nullptr && mcc->isIdling()) {
+			_offers.push_back({ mcc, mcc->node(), mcc->contributedItemId(), mcc->constraintItemId() });
+		}
+	}
+
+	// Cycles have as many members as the longest exchange of the agent search
+	_cycles.clear();
+	_solver.solve(_offers, g_Config.maxSearchDepth + 2, _cycles);
+
+	for (auto &cycle : _cycles)
+	{
+		for (auto offerIndex : cycle)
+		{
+			Agent *agent = _offers[offerIndex].agent;
+			if (agent->asMCP() != nullptr) {
+				agent->asMCP()->commitExchange();
+			} else {
+				agent->asMCC()->commitExchange();
+			}
+		}
+		iLog << "Solver exchange among " << (int)cycle.size() << " nodes";
+	}
+
+	_solverExchanges += (unsigned int)_cycles.size();
+	_totalSolverExchanges += _cycles.size();
+	_solverRuns++;
+	_solverSeconds += std::chrono::duration<double>(Clock::now() - solverStart).count();
+}
+
+void ModuleNodeCluster::updateExchangeMetrics()
+{
+	// Rates over windows of one second
+	const Clock::time_point now = Clock::now();
+	const double windowSeconds = std::chrono::duration<double>(now - _metricsStart).count();
+	if (windowSeconds >= 1.0)
+	{
+		_agentExchangesPerSecond = _agentExchanges / windowSeconds;
+		_solverExchangesPerSecond = _solverExchanges / windowSeconds;
+		_solverMillisPerRun = (_solverRuns > 0) ? 1000.0 * _solverSeconds / _solverRuns : 0.0;
+		_agentExchanges = 0;
+		_solverExchanges = 0;
+		_solverRuns = 0;
+		_solverSeconds = 0.0;
+		_metricsStart = now;
+	}
+}
+
+bool ModuleNodeCluster::isRunning() const
+{
+	return state == RUNNING;
+}
+
+void ModuleNodeCluster::spawnMCCs()
+{
+	// Half of the free agent ids are left for the agents of the searches
+	// (each negotiation creates a UCC, and each UCP a child MCP)
+	size_t budget = App->agentContainer->freeAgentCount() / 2;
+	size_t skipped = 0;
+
+	for (NodePtr node : _nodes)
+	{
+		const ItemSet spareItems = node->itemList().spareItems();
+		const ItemSet missingItems = node->itemList().missingItems();
+		if (spareItems.none() || missingItems.none()) {
+			continue;
+		}
+
+		// One MCC per spare item and missing item first, then the rest
+		// of spare units, until the limit of the node
+		unsigned int spawned = 0;
+		for (unsigned int unit = 1; ; ++unit)
+		{
+			bool unitsLeft = false;
+			spareItems.forEach([&](ItemId contributedItem)
+			{
+				if (node->itemList().numItemsWithId(contributedItem) <= unit) {
+					return;
+				}
+				unitsLeft = true;
+
+				missingItems.forEach([&](ItemId constraintItem)
+				{
+					if (spawned < MAX_SPAWNED_MCCS_PER_NODE && budget > 0) {
+						spawnMCC(node->id(), contributedItem, constraintItem);
+						spawned++;
+						budget--;
+					}
+					else {
+						skipped++;
+					}
+				});
+			});
+
+			if (!unitsLeft) {
+				break;
+			}
+		}
+	}
+
+	if (skipped > 0) {
+		wLog << "spawnMCCs() - " << (unsigned int)skipped << " MCCs not spawned (at most "
+			<< MAX_SPAWNED_MCCS_PER_NODE << " per node, and half of the free agent ids)";
+	}
 }
 
 void ModuleNodeCluster::stopSystem()
 {
+	App->networkManager->setLoopbackPort(0);
+
+	_mccDirectory.clear();
+	_searchCache.clear();
 }
 
 void ModuleNodeCluster::spawnMCP(int nodeId, int requestedItemId, int contributedItemId)
@@ -5,6 +5,10 @@
 #include "Node.h"
 #include "MCC.h"
 #include "MCP.h"
+#include "MCCDirectory.h"
+#include "ExchangeSolver.h"
+#include "SearchCache.h"
+#include <chrono>
 
 class ModuleNodeCluster : public Module, public TCPNetworkManagerDelegate
 {
@@ -33,6 +37,41 @@ public:
 
 	void OnDisconnected(TCPSocketPtr socket) override;
 
+	void OnConnectFailed(TCPSocketPtr socket) override;
+
+
+	// Local copy of the YellowPages (used by MCPs)
+
+	MCCDirectory &mccDirectory() { return _mccDirectory; }
+
+	// Recent results of the sub-searches (used by UCPs)
+
+	SearchCache &searchCache() { return _searchCache; }
+
+
+	// Simulation control (from the GUI or the ModuleSimulationDriver)
+
+	bool isRunning() const;
+
+	const std::vector<NodePtr> &nodes() const { return _nodes; }
+
+	void spawnMCP(int nodeId, int requestedItemId, int contributedItemId);
+
+	void spawnMCC(int nodeId, int contributedItemId, int constraintItemId);
+
+	// MCCs for every spare item of each node, wanting each missing item
+	// (at most MAX_SPAWNED_MCCS_PER_NODE per node)
+	void spawnMCCs();
+
+	void setSolverEnabled(bool enabled) { _solverEnabled = enabled; }
+
+	// Exchanges since the system started
+	uint64_t totalAgentExchanges() const { return _totalAgentExchanges; }
+	uint64_t totalSolverExchanges() const { return _totalSolverExchanges; }
+
+	// Milliseconds from the creation of each MCP of the users to the end of its search
+	const std::vector<double> &negotiationLatencies() const { return _negotiationLatencies; }
+
 private:
 
 	bool startSystem();
@@ -41,14 +80,38 @@ private:
 
 	void stopSystem();
 
+	// It looks for exchanges among the agents with the ExchangeSolver
+	void runSolver();
 
-	void spawnMCP(int nodeId, int requestedItemId, int contributedItemId);
-
-	void spawnMCC(int nodeId, int contributedItemId, int constraintItemId);
+	// Exchanges per second found by each method
+	void updateExchangeMetrics();
 
 
 
 	std::vector<NodePtr> _nodes; /**< Array of nodes spawn in this host. */
 
+	MCCDirectory _mccDirectory; /**< MCCs of the subscribed items. */
+
+	SearchCache _searchCache; /**< Results of the sub-searches. */
+
+	bool _solverEnabled = false; /**< Whether or not the ExchangeSolver runs every frame. */
+	ExchangeSolver _solver; /**< Centralized search of exchange cycles. */
+	std::vector<ExchangeSolver::Offer> _offers; /**< Offers given to the solver (reused every frame). */
+	std::vector<ExchangeSolver::Cycle> _cycles; /**< Cycles found by the solver (reused every frame). */
+
+	// Benchmark of the agent search against the solver
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point _metricsStart; /**< Start of the current measurement window. */
+	unsigned int _agentExchanges = 0; /**< Exchanges found by MCPs in the window. */
+	unsigned int _solverExchanges = 0; /**< Exchanges found by the solver in the window. */
+	unsigned int _solverRuns = 0; /**< Solver runs in the window. */
+	double _solverSeconds = 0.0; /**< Time spent in the solver in the window. */
+	double _agentExchangesPerSecond = 0.0;
+	double _solverExchangesPerSecond = 0.0;
+	double _solverMillisPerRun = 0.0;
+	uint64_t _totalAgentExchanges = 0;
+	uint64_t _totalSolverExchanges = 0;
+	std::vector<double> _negotiationLatencies; /**< Of the MCPs finished since the system started. */
+
 	int state = 0; /**< State machine. */
 };
@@ -0,0 +1,363 @@
+#include "ModuleSimulationDriver.h"
+#include "ModuleAgentContainer.h"
+#include "ModuleNetworkManager.h"
+#include "ModuleNodeCluster.h"
+#include "ModuleYellowPages.h"
+#include "Application.h"
+#include "Globals.h"
+#include "Log.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+// Frames run without script nor --frames
+static const unsigned int DEFAULT_HEADLESS_FRAMES = 1000U;
+
+// Frames without searches before the system is considered idle
+// (packets in flight take a few frames to reach the agents)
+static const unsigned int IDLE_FRAMES = 10U;
+
+// Scenario of the benchmarks without script: every node looks for one
+// of its missing items once all the possible offers are registered
+static const char *DEFAULT_BENCHMARK_SCRIPT =
+	"0 mccs\n"
+	"0 wait_mccs\n"
+	"0 random_mcps\n"
+	"0 wait_idle\n"
+	"0 quit\n";
+
+bool ModuleSimulationDriver::start()
+{
+	if (g_Config.headlessYellowPages)
+	{
+		// A YellowPages process just serves until it is closed
+		App->modYellowPages->setClusterPosition(g_Config.ypPartition, g_Config.ypReplica);
+		App->modYellowPages->setEnabled(true);
+		return true;
+	}
+
+	_commands.clear();
+	_nextCommand = 0;
+	_frame = 0;
+	_quit = false;
+	_wait = Wait::None;
+	_measuring = false;
+
+	if (!g_Config.scriptPath.empty())
+	{
+		if (!loadScript(g_Config.scriptPath)) {
+			eLog << "Could not load the script " << g_Config.scriptPath;
+			return false;
+		}
+	}
+	else if (!g_Config.benchmarkReportPath.empty())
+	{
+		std::istringstream script(DEFAULT_BENCHMARK_SCRIPT);
+		parseScript(script);
+	}
+	else
+	{
+		_commands.push_back({ 0U, "mccs", {} });
+		if (g_Config.frames == 0) {
+			_commands.push_back({ DEFAULT_HEADLESS_FRAMES, "quit", {} });
+		}
+	}
+
+	// With a seed, the agents are updated in order so that runs can be repeated
+	if (g_Config.randomSeed != 0) {
+		_random.seed(g_Config.randomSeed);
+		App->agentContainer->setUpdateThreadCount(0);
+	} else {
+		_random.seed(std::random_device{}());
+	}
+
+	App->agentContainer->setEnabled(true);
+	App->modNodeCluster->setEnabled(true);
+
+	return true;
+}
+
+bool ModuleSimulationDriver::update()
+{
+	if (g_Config.headlessYellowPages || _quit || !App->modNodeCluster->isRunning()) {
+		return true;
+	}
+
+	if (_frame == 0) {
+		_startTime = Clock::now();
+	}
+
+	if (_wait != Wait::None && waitFinished()) {
+		_wait = Wait::None;
+	}
+
+	while (_wait == Wait::None && _nextCommand < _commands.size() && _commands[_nextCommand].frame <= _frame) {
+		runCommand(_commands[_nextCommand++]);
+	}
+
+	_frame++;
+	if (g_Config.frames != 0 && _frame >= g_Config.frames) {
+		_quit = true;
+	}
+
+	if (_quit) {
+		logReport();
+		App->exit();
+	}
+
+	return true;
+}
+
+bool ModuleSimulationDriver::stop()
+{
+	_commands.clear();
+	_nextCommand = 0;
+
+	return true;
+}
+
+bool ModuleSimulationDriver::loadScript(const std::string &path)
+{
+	std::ifstream file(path.c_str());
+	if (!file.is_open()) {
+		return false;
+	}
+
+	parseScript(file);
+
+	iLog << "Script " << path << " loaded: " << (int)_commands.size() << " commands";
+	return true;
+}
+
+void ModuleSimulationDriver::parseScript(std::istream &input)
+{
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(input, line))
+	{
+		lineNumber++;
+
+		// Blank lines and comments
+		const size_t firstChar = line.find_first_not_of(" \t\r");
+		if (firstChar == std::string::npos || line[firstChar] == '#') {
+			continue;
+		}
+
+		std::istringstream tokens(line);
+		Command command;
+		if (!(tokens >> command.frame >> command.name)) {
+			wLog << "Script line " << lineNumber << " ignored: " << line;
+			continue;
+		}
+
+		std::string arg;
+		while (tokens >> arg) {
+			command.args.push_back(arg);
+		}
+		_commands.push_back(command);
+	}
+
+	// Commands of the same frame keep their order
+	std::stable_sort(_commands.begin(), _commands.end(), [](const Command &a, const Command &b) {
+		return a.frame < b.frame;
+	});
+}
+
+void ModuleSimulationDriver::runCommand(const Command &command)
+{
+	std::vector<int> args;
+	for (auto &arg : command.args) {
+		args.push_back(atoi(arg.c_str()));
+	}
+
+	// Measures start with the first search
+	const bool spawnsMCPs = (command.name == "mcp" || command.name == "random_mcps");
+	if (spawnsMCPs && !_measuring) {
+		startMeasure();
+	}
+
+	if (command.name == "mcc" && args.size() == 3) {
+		App->modNodeCluster->spawnMCC(args[0], args[1], args[2]);
+	}
+	else if (command.name == "mcp" && args.size() == 3) {
+		App->modNodeCluster->spawnMCP(args[0], args[1], args[2]);
+	}
+	else if (command.name == "mccs") {
+		App->modNodeCluster->spawnMCCs();
+	}
+	else if (command.name == "random_mcps" && args.size() <= 1) {
+		spawnRandomMCPs(args.empty() ? (int)App->modNodeCluster->nodes().size() : args[0]);
+	}
+	else if (command.name == "solver" && command.args.size() == 1) {
+		App->modNodeCluster->setSolverEnabled(command.args[0] == "on");
+	}
+	else if (command.name == "wait_mccs" || command.name == "wait_idle") {
+		_wait = (command.name == "wait_mccs") ? Wait::MCCs : Wait::Idle;
+		_waitFrame = _frame;
+		_idleFrames = 0;
+	}
+	else if (command.name == "quit") {
+		_quit = true;
+	}
+	else {
+		wLog << "Unknown script command at frame " << command.frame << ": " << command.name;
+	}
+}
+
+void ModuleSimulationDriver::spawnRandomMCPs(int count)
+{
+	const std::vector<NodePtr> &nodes = App->modNodeCluster->nodes();
+	if (nodes.empty()) {
+		return;
+	}
+
+	std::uniform_int_distribution<size_t> randomNode(0, nodes.size() - 1);
+	std::vector<ItemId> spareItems;
+	std::vector<ItemId> missingItems;
+
+	for (int i = 0; i < count; ++i)
+	{
+		// Nodes without spare or missing items cannot ask for an exchange
+		Node *node = nodes[randomNode(_random)].get();
+		spareItems.clear();
+		missingItems.clear();
+		node->itemList().spareItems().forEach([&](ItemId itemId) { spareItems.push_back(itemId); });
+		node->itemList().missingItems().forEach([&](ItemId itemId) { missingItems.push_back(itemId); });
+		if (spareItems.empty() || missingItems.empty()) {
+			continue;
+		}
+
+		const ItemId requestedItem = missingItems[std::uniform_int_distribution<size_t>(0, missingItems.size() - 1)(_random)];
+		const ItemId contributedItem = spareItems[std::uniform_int_distribution<size_t>(0, spareItems.size() - 1)(_random)];
+		App->modNodeCluster->spawnMCP(node->id(), requestedItem, contributedItem);
+	}
+}
+
+bool ModuleSimulationDriver::waitFinished()
+{
+	// Agents spawned in the frame of the command are added at its end
+	if (_frame <= _waitFrame) {
+		return false;
+	}
+
+	if (_wait == Wait::MCCs)
+	{
+		for (auto &agent : App->agentContainer->allAgents()) {
+			MCC *mcc = agent->asMCC();
+			if (agent->isValid() && mcc != nullptr && !mcc->isIdling()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// MCCs remain waiting for petitions, the rest of agents belong to searches
+	bool searching = false;
+	for (auto &agent : App->agentContainer->allAgents()) {
+		if (agent->isValid() && agent->asMCC() == nullptr) {
+			searching = true;
+			break;
+		}
+	}
+	_idleFrames = searching ? 0 : _idleFrames + 1;
+	return _idleFrames >= IDLE_FRAMES;
+}
+
+void ModuleSimulationDriver::startMeasure()
+{
+	_measuring = true;
+	_measureFrame = _frame;
+	_measureTime = Clock::now();
+	_measureExchanges = App->modNodeCluster->totalAgentExchanges() + App->modNodeCluster->totalSolverExchanges();
+	App->networkManager->socketTraffic(_measurePackets, _measureBytes);
+	App->networkManager->loopbackTraffic(_measureLoopbackPackets, _measureLoopbackBytes);
+	_measureLatencies = App->modNodeCluster->negotiationLatencies().size();
+}
+
+void ModuleSimulationDriver::logReport()
+{
+	const double seconds = std::chrono::duration<double>(Clock::now() - _startTime).count();
+
+	unsigned int missingItems = 0;
+	for (auto &node : App->modNodeCluster->nodes()) {
+		missingItems += node->itemList().numMissingItems();
+	}
+
+	iLog << "Headless run finished: " << _frame << " frames in " << seconds << " s"
+		<< " (" << (seconds > 0.0 ? _frame / seconds : 0.0) << " frames/s)";
+	iLog << " - exchanges found by agents: " << (unsigned int)App->modNodeCluster->totalAgentExchanges();
+	iLog << " - exchanges found by the solver: " << (unsigned int)App->modNodeCluster->totalSolverExchanges();
+	iLog << " - agents alive: " << (unsigned int)App->agentContainer->allAgents().size();
+	iLog << " - missing items in the cluster: " << missingItems;
+
+	if (g_Config.benchmarkReportPath.empty()) {
+		return;
+	}
+	if (!_measuring) {
+		startMeasure();
+	}
+
+	// Metrics since the first MCP
+	const double measureSeconds = std::chrono::duration<double>(Clock::now() - _measureTime).count();
+	const double perSecond = (measureSeconds > 0.0) ? 1.0 / measureSeconds : 0.0;
+	const uint64_t exchanges = App->modNodeCluster->totalAgentExchanges() + App->modNodeCluster->totalSolverExchanges() - _measureExchanges;
+	uint64_t packets, bytes, loopbackPackets, loopbackBytes;
+	App->networkManager->socketTraffic(packets, bytes);
+	App->networkManager->loopbackTraffic(loopbackPackets, loopbackBytes);
+	packets -= _measurePackets;
+	bytes -= _measureBytes;
+	loopbackPackets -= _measureLoopbackPackets;
+	loopbackBytes -= _measureLoopbackBytes;
+
+	// Nearest-rank percentiles of the searches finished in the measure
+	const std::vector<double> &allLatencies = App->modNodeCluster->negotiationLatencies();
+	std::vector<double> latencies(allLatencies.begin() + _measureLatencies, allLatencies.end());
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&latencies](double p) {
+		return latencies.empty() ? 0.0 : latencies[(size_t)(p * (latencies.size() - 1))];
+	};
+
+	std::ostringstream report;
+	report << "{\"nodes\":" << g_Config.maxNodes
+		<< ",\"items\":" << g_Config.maxItems
+		<< ",\"depth\":" << g_Config.maxSearchDepth
+		<< ",\"seed\":" << g_Config.randomSeed
+		<< ",\"frames\":" << (_frame - _measureFrame)
+		<< ",\"seconds\":" << measureSeconds
+		<< ",\"exchanges\":" << exchanges
+		<< ",\"exchanges_per_second\":" << exchanges * perSecond
+		<< ",\"searches\":" << latencies.size()
+		<< ",\"packets\":" << packets
+		<< ",\"packets_per_second\":" << packets * perSecond
+		<< ",\"bytes\":" << bytes
+		<< ",\"loopback_packets\":" << loopbackPackets
+		<< ",\"loopback_bytes\":" << loopbackBytes
+		<< ",\"latency_p50_ms\":" << percentile(0.50)
+		<< ",\"latency_p99_ms\":" << percentile(0.99)
+		<< ",\"peak_agents\":" << App->agentContainer->peakAgentCount()
+		<< ",\"missing_items\":" << missingItems
+		<< "}";
+
+	// Also in the log (stdout of the Headless configuration, --log file)
+	iLog << "Benchmark: " << report.str();
+
+	// One line per run, so results can be appended and compared
+	if (!appendLine(g_Config.benchmarkReportPath, report.str())) {
+		eLog << "Could not write the benchmark report " << g_Config.benchmarkReportPath;
+	}
+
+	// Next to the last dump of the metrics of the run
+	if (!g_Config.metricsPath.empty() && !appendLine(g_Config.metricsPath, "{\"benchmark\":" + report.str() + "}")) {
+		eLog << "Could not write the metrics file " << g_Config.metricsPath;
+	}
+}
+
+bool ModuleSimulationDriver::appendLine(const std::string &path, const std::string &line)
+{
+	std::ofstream file(path.c_str(), std::ios::out | std::ios::app);
+	if (!file.is_open()) {
+		return false;
+	}
+	file << line << std::endl;
+	return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Module.h"
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * It runs the simulation without window nor GUI (option --headless).
+ * The node cluster (or a YellowPages process) is started at once and
+ * the agents are spawned from a script with one command per line:
+ *
+ *   <frame> mcc <node> <contributed item> <constraint item>
+ *   <frame> mcp <node> <requested item> <contributed item>
+ *   <frame> mccs                   (MCCs for all spare/missing items)
+ *   <frame> random_mcps [count]    (MCPs of random nodes and items, one per node by default)
+ *   <frame> solver on|off
+ *   <frame> wait_mccs              (until all the MCCs are registered)
+ *   <frame> wait_idle              (until all the searches finished)
+ *   <frame> quit
+ *
+ * Frames are counted since the node cluster started, and each one runs
+ * right after the previous one (there is no frame rate limit). The wait
+ * commands delay the rest of the script. Lines starting with # are
+ * comments.
+ *
+ * Benchmarks (option --benchmark <file>) run by default the scenario
+ * of DEFAULT_BENCHMARK_SCRIPT and append a JSON line to the file with
+ * the metrics measured since the first MCP was spawned. The line is
+ * also logged and, with --metrics <file>, appended to the metrics file.
+ * Scripted benchmarks should use the Headless configuration, a console
+ * program whose log goes to stdout (the GUI build has no console, so
+ * use --log <file> there).
+ */
+class ModuleSimulationDriver : public Module
+{
+public:
+
+	// Virtual methods from parent class Module
+
+	bool start() override;
+
+	bool update() override;
+
+	bool stop() override;
+
+private:
+
+	/** Line of the script. */
+	struct Command
+	{
+		unsigned int frame;
+		std::string name;
+		std::vector<std::string> args;
+	};
+
+	bool loadScript(const std::string &path);
+
+	void parseScript(std::istream &input);
+
+	void runCommand(const Command &command);
+
+	void spawnRandomMCPs(int count);
+
+	// Whether the condition of the current wait command holds
+	bool waitFinished();
+
+	// It takes the initial values of the metrics
+	void startMeasure();
+
+	// Summary of the run, written to the log (and the benchmark report)
+	void logReport();
+
+	// It appends a line to the file, it returns false if it cannot be opened
+	static bool appendLine(const std::string &path, const std::string &line);
+
+
+	std::vector<Command> _commands; /**< Script, sorted by frame. */
+	size_t _nextCommand = 0; /**< First command not run yet. */
+	unsigned int _frame = 0; /**< Frames since the node cluster started. */
+	bool _quit = false; /**< Whether the run finished. */
+
+	enum class Wait { None, MCCs, Idle };
+	Wait _wait = Wait::None; /**< Wait command delaying the script. */
+	unsigned int _waitFrame = 0; /**< Frame of the wait command. */
+	unsigned int _idleFrames = 0; /**< Consecutive frames without searches. */
+
+	std::mt19937 _random; /**< Source of the random spawns (seeded with --seed). */
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point _startTime; /**< Time of the first frame. */
+
+	// Metrics at the start of the measure
+	bool _measuring = false;
+	unsigned int _measureFrame = 0;
+	Clock::time_point _measureTime;
+	uint64_t _measureExchanges = 0;
+	uint64_t _measurePackets = 0;
+	uint64_t _measureBytes = 0;
+	uint64_t _measureLoopbackPackets = 0;
+	uint64_t _measureLoopbackBytes = 0;
+	size_t _measureLatencies = 0;
+};
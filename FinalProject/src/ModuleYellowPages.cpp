@@ -1,6 +1,7 @@
 #include "ModuleYellowPages.h"
 #include "ModuleNetworkManager.h"
 #include "Application.h"
+#include "YellowPagesCluster.h"
 #include "Packets.h"
 #include "Log.h"
 #include "imgui/imgui.h"
@@ -58,25 +59,31 @@ bool ModuleYellowPages::updateGUI()
 	// Number of sockets
 	App->networkManager->drawInfoGUI();
 
+	if (g_Config.ypPartitions * g_Config.ypReplicas > 1 && ImGui::CollapsingHeader("Cluster", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::TextWrapped("Partition: %d of %d", _partition, g_Config.ypPartitions);
+		ImGui::TextWrapped("Replica: %d of %d", _replica, g_Config.ypReplicas);
+		ImGui::TextWrapped("Listen port: %d", (int)yellowPagesPort(_partition, _replica));
+	}
+
 	ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_DefaultOpen;
 	if (ImGui::CollapsingHeader("Registered MCCs", flags))
 	{
+		ImGui::TextWrapped("# registered MCCs: %d", (int)_mccByItem.size());
+
 		int imguiId = 0;
-		for (auto &mcc : _mccByItem)
+		_mccByItem.visit([&](uint16_t itemId, const std::vector<AgentLocation> &agentLocations)
 		{
-			auto itemId = mcc.first;
-			auto &agentLocations = mcc.second;
-
-			if (ImGui::TreeNodeEx((void*)imguiId++, flags, "MCCs for item %d", (int)itemId))
+			if (ImGui::TreeNodeEx((void*)(intptr_t)imguiId++, flags, "MCCs for item %d (%d)", (int)itemId, (int)agentLocations.size()))
 			{
 				for (auto &agentLocation : agentLocations)
 				{
-					ImGui::Text(" - %s:%d - agent:%d", agentLocation.hostIP.c_str(), agentLocation.hostPort, agentLocation.agentId);
+					ImGui::Text(" - %s:%d - agent:%u", agentLocation.hostIP.c_str(), agentLocation.hostPort, agentLocation.agentId);
 				}
 
 				ImGui::TreePop();
 			}
-		}
+		});
 	}
 
 	ImGui::End();
@@ -91,6 +98,12 @@ bool ModuleYellowPages::stop()
 	return true;
 }
 
+void ModuleYellowPages::setClusterPosition(int partition, int replica)
+{
+	_partition = partition;
+	_replica = replica;
+}
+
 bool ModuleYellowPages::startService()
 {
 	iLog << "--------------------------------------------";
@@ -106,13 +119,16 @@ bool ModuleYellowPages::startService()
 	}
 	iLog << " - Server Listen socket created";
 
-	// Bind
-	const int port = LISTEN_PORT_YP;
-	SocketAddress bindAddress(port); // localhost:LISTEN_PORT_YP
+	// Bind (each process of the cluster has its own port)
+	const int port = yellowPagesPort(_partition, _replica);
+	SocketAddress bindAddress(port); // localhost:port
 	listenSocket->SetReuseAddress(true);
 	int res = listenSocket->Bind(bindAddress);
 	if (res != NO_ERROR) { return false; }
-	iLog << " - Socket Bind to interface 127.0.0.1:" << LISTEN_PORT_YP;
+	iLog << " - Socket Bind to interface 127.0.0.1:" << port;
+	if (g_Config.ypPartitions * g_Config.ypReplicas > 1) {
+		iLog << " - Partition " << _partition << " (replica " << _replica << ")";
+	}
 
 	// Listen mode
 	res = listenSocket->Listen();
@@ -141,6 +157,7 @@ void ModuleYellowPages::OnPacketReceived(TCPSocketPtr socket, InputMemoryStream
 	// Read packet header
 	PacketHeader inPacketHead;
 	inPacketHead.Read(stream);
+	ModuleNetworkManager::countPacket(inPacketHead.packetType, stream.GetCapacity(), false);
 
 	if (inPacketHead.packetType == PacketType::RegisterMCC)
 	{
@@ -153,7 +170,10 @@ void ModuleYellowPages::OnPacketReceived(TCPSocketPtr socket, InputMemoryStream
 		mcc.hostIP = socket->RemoteAddress().GetIPString();
 		mcc.hostPort = LISTEN_PORT_AGENTS;
 		mcc.agentId = inPacketHead.srcAgentId;
-		_mccByItem[inPacketData.itemId].push_back(mcc);
+		// (MCCs register again when the acknowledgement is late)
+		if (_mccByItem.registerMCC(inPacketData.itemId, mcc)) {
+			notifySubscribers(PacketType::MCCRegistered, inPacketData.itemId, mcc);
+		}
 
 		// Host address
 		std::string hostAddress = socket->RemoteAddress().GetString();
@@ -173,16 +193,12 @@ void ModuleYellowPages::OnPacketReceived(TCPSocketPtr socket, InputMemoryStream
 		inPacketData.Read(stream);
 
 		// Unregister the MCC from the yellow pages
-		std::list<AgentLocation> &mccs(_mccByItem[inPacketData.itemId]);
-		for (auto it = mccs.begin(); it != mccs.end();) {
-			if (it->agentId == inPacketHead.srcAgentId) {
-				auto oldIt = it++;
-				mccs.erase(oldIt);
-				break;
-			}
-			else {
-				++it;
-			}
+		AgentLocation mcc;
+		mcc.hostIP = socket->RemoteAddress().GetIPString();
+		mcc.hostPort = LISTEN_PORT_AGENTS;
+		mcc.agentId = inPacketHead.srcAgentId;
+		if (_mccByItem.unregisterMCC(inPacketData.itemId, mcc)) {
+			notifySubscribers(PacketType::MCCUnregistered, inPacketData.itemId, mcc);
 		}
 
 		//// Send RegisterMCCAck packet
@@ -193,29 +209,92 @@ void ModuleYellowPages::OnPacketReceived(TCPSocketPtr socket, InputMemoryStream
 		//outPacket.Write(outStream);
 		//socket->SendPacket(outStream.GetBufferPtr(), outStream.GetSize());
 	}
+	else if (inPacketHead.packetType == PacketType::RegisterMCCBatch)
+	{
+		// Read the packet
+		PacketRegisterMCCBatch inPacketData;
+		inPacketData.Read(stream);
+
+		// Register all the MCCs and acknowledge them with a single packet
+		PacketRegisterMCCBatchAck outPacketData;
+		outPacketData.agentIds.reserve(inPacketData.mccs.size());
+		AgentLocation mcc;
+		mcc.hostIP = socket->RemoteAddress().GetIPString();
+		mcc.hostPort = LISTEN_PORT_AGENTS;
+		for (auto &entry : inPacketData.mccs)
+		{
+			mcc.agentId = entry.agentId;
+			if (_mccByItem.registerMCC(entry.itemId, mcc)) {
+				notifySubscribers(PacketType::MCCRegistered, entry.itemId, mcc);
+			}
+			outPacketData.agentIds.push_back(entry.agentId);
+		}
+
+		// Send RegisterMCCBatchAck packet
+		OutputMemoryStream outStream;
+		PacketHeader outPacketHead;
+		outPacketHead.packetType = PacketType::RegisterMCCBatchAck;
+		outPacketHead.Write(outStream);
+		outPacketData.Write(outStream);
+		socket->SendPacket(outStream.GetBufferPtr(), outStream.GetSize());
+	}
+	else if (inPacketHead.packetType == PacketType::UnregisterMCCBatch)
+	{
+		// Read the packet
+		PacketUnregisterMCCBatch inPacketData;
+		inPacketData.Read(stream);
+
+		// Unregister all the MCCs
+		AgentLocation mcc;
+		mcc.hostIP = socket->RemoteAddress().GetIPString();
+		mcc.hostPort = LISTEN_PORT_AGENTS;
+		for (auto &entry : inPacketData.mccs)
+		{
+			mcc.agentId = entry.agentId;
+			if (_mccByItem.unregisterMCC(entry.itemId, mcc)) {
+				notifySubscribers(PacketType::MCCUnregistered, entry.itemId, mcc);
+			}
+		}
+	}
 	else if (inPacketHead.packetType == PacketType::QueryMCCsForItem)
 	{
 		// Read packet
 		PacketQueryMCCsForItem inPacketData;
 		inPacketData.Read(stream);
 
-		// Response packet
-		PacketReturnMCCsForItem outPacketData;
-
-		// Obtain the MCCAddresses
+		// Obtain the MCCAddresses (already serialized as a PacketReturnMCCsForItem)
 		auto itemId = inPacketData.itemId;
-		auto &mccAddressList = _mccByItem[itemId];
-		for (auto &mccAddress : mccAddressList) {
-			outPacketData.mccAddresses.push_back(mccAddress);
-		}
+		MCCRegistry::SerializedMCCs outPacketData = _mccByItem.serializedMCCs(itemId);
 
 		// Send response packet
-		OutputMemoryStream outStream;
 		PacketHeader outPacketHead;
 		outPacketHead.packetType = PacketType::ReturnMCCsForItem;
 		outPacketHead.dstAgentId = inPacketHead.srcAgentId;
+		OutputMemoryStream outStream(static_cast<uint32_t>(outPacketData->size() + 16));
 		outPacketHead.Write(outStream);
-		outPacketData.Write(outStream);
+		outStream.Write(outPacketData->data(), outPacketData->size());
+		socket->SendPacket(outStream.GetBufferPtr(), outStream.GetSize());
+	}
+	else if (inPacketHead.packetType == PacketType::SubscribeMCCsForItem)
+	{
+		// Read packet
+		PacketSubscribeMCCsForItem inPacketData;
+		inPacketData.Read(stream);
+
+		// Register the subscription (changes are pushed from now on)
+		auto itemId = inPacketData.itemId;
+		if (_subscribersByItem[itemId].insert(socket).second) {
+			_itemsBySubscriber[socket].push_back(itemId);
+		}
+
+		// Send the current MCCs
+		MCCRegistry::SerializedMCCs mccs = _mccByItem.serializedMCCs(itemId);
+		PacketHeader outPacketHead;
+		outPacketHead.packetType = PacketType::SnapshotMCCsForItem;
+		OutputMemoryStream outStream(static_cast<uint32_t>(mccs->size() + 16));
+		outPacketHead.Write(outStream);
+		outStream.Write(itemId);
+		outStream.Write(mccs->data(), mccs->size());
 		socket->SendPacket(outStream.GetBufferPtr(), outStream.GetSize());
 	}
 	else
@@ -226,6 +305,34 @@ void ModuleYellowPages::OnPacketReceived(TCPSocketPtr socket, InputMemoryStream
 
 void ModuleYellowPages::OnDisconnected(TCPSocketPtr socket)
 {
-	// Nothing to do
-	//iLog << "Socket disconnected gracefully";
+	// Subscriptions finish with the connection
+	auto it = _itemsBySubscriber.find(socket);
+	if (it != _itemsBySubscriber.end())
+	{
+		for (auto itemId : it->second) {
+			_subscribersByItem[itemId].erase(socket);
+		}
+		_itemsBySubscriber.erase(it);
+	}
+}
+
+void ModuleYellowPages::notifySubscribers(PacketType packetType, uint16_t itemId, const AgentLocation &mcc)
+{
+	auto it = _subscribersByItem.find(itemId);
+	if (it == _subscribersByItem.end() || it->second.empty()) {
+		return;
+	}
+
+	PacketHeader outPacketHead;
+	outPacketHead.packetType = packetType;
+	PacketMCCDelta outPacketData;
+	outPacketData.itemId = itemId;
+	outPacketData.mcc = mcc;
+
+	OutputMemoryStream outStream;
+	outPacketHead.Write(outStream);
+	outPacketData.Write(outStream);
+	for (auto &socket : it->second) {
+		socket->SendPacket(outStream.GetBufferPtr(), outStream.GetSize());
+	}
 }
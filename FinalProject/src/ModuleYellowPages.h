@@ -2,8 +2,11 @@
 
 #include "Module.h"
 #include "AgentLocation.h"
+#include "Packets.h"
+#include "MCCRegistry.h"
 #include "net/Net.h"
-#include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 class IDatabaseGateway;
 
@@ -32,13 +35,27 @@ public:
 
 	void OnDisconnected(TCPSocketPtr socket) override;
 
+
+	// Position of this process in the YellowPages cluster (before starting)
+
+	void setClusterPosition(int partition, int replica);
+
 private:
 
 	bool startService();
 
 	void stopService();
 
+	// It pushes a change of the MCCs of an item to its subscribers
+	void notifySubscribers(PacketType packetType, uint16_t itemId, const AgentLocation &mcc);
+
 	int state = 0;
 
-	std::map<uint16_t, std::list<AgentLocation> > _mccByItem; /**< MCCs accessed by item id. */
+	int _partition = 0; /**< Partition of the items handled by this process. */
+	int _replica = 0; /**< Replica of the partition. */
+
+	MCCRegistry _mccByItem; /**< MCCs accessed by item id. */
+
+	std::unordered_map<uint16_t, std::unordered_set<TCPSocketPtr>> _subscribersByItem; /**< Connections subscribed to each item. */
+	std::unordered_map<TCPSocketPtr, std::vector<uint16_t>> _itemsBySubscriber; /**< Items subscribed by each connection. */
 };
\ No newline at end of file
@@ -2,7 +2,8 @@
 
 
 Node::Node(int pid) :
-	_id(pid)
+	_id(pid),
+	_itemList(g_Config.maxItems)
 {
 }
 
@@ -14,23 +14,55 @@ enum class PacketType
 	RegisterMCCAck,
 	UnregisterMCC,
 
+	// Node cluster <-> YP (MCC registrations coalesced by the agent container)
+	RegisterMCCBatch,
+	RegisterMCCBatchAck,
+	UnregisterMCCBatch,
+
 	// MCP <-> YP
 	QueryMCCsForItem,
 	ReturnMCCsForItem,
 
+	// Node cluster <-> YP (subscriptions, no agents involved)
+	SubscribeMCCsForItem,
+	SnapshotMCCsForItem,
+	MCCRegistered,
+	MCCUnregistered,
+
 	// MCP <-> MCC
 	RequestForNegotiation,
 	ReturnForNegotiation,
+	ReleaseNegotiation,
 
 	// UCP <-> UCC
 	RequestForItem,
 	RequestForConstraint,
 	ResultForConstraint,
 	AcknowledgeForConstraint,
-	
+	CancelNegotiation,
+
 	Last
 };
 
+/**
+ * Name of the packet type (used by the metrics).
+ */
+inline const char *packetTypeName(PacketType packetType)
+{
+	static const char *names[] = {
+		"RegisterMCC", "RegisterMCCAck", "UnregisterMCC",
+		"RegisterMCCBatch", "RegisterMCCBatchAck", "UnregisterMCCBatch",
+		"QueryMCCsForItem", "ReturnMCCsForItem",
+		"SubscribeMCCsForItem", "SnapshotMCCsForItem", "MCCRegistered", "MCCUnregistered",
+		"RequestForNegotiation", "ReturnForNegotiation", "ReleaseNegotiation",
+		"RequestForItem", "RequestForConstraint", "ResultForConstraint", "AcknowledgeForConstraint", "CancelNegotiation"
+	};
+	static_assert(sizeof(names) / sizeof(names[0]) == (size_t)PacketType::Last, "Missing packet type names");
+
+	const size_t index = (size_t)packetType;
+	return (index < (size_t)PacketType::Last) ? names[index] : "Unknown";
+}
+
 /**
  * Standard information used by almost all messages in the system.
  * Agents will be communicating among each other, so in many cases,
@@ -40,8 +72,8 @@ enum class PacketType
 class PacketHeader {
 public:
 	PacketType packetType; // Which type is this packet
-	uint16_t srcAgentId;   // Which agent sent this packet?
-	uint16_t dstAgentId;   // Which agent is expected to receive the packet?
+	AgentId srcAgentId;    // Which agent sent this packet?
+	AgentId dstAgentId;    // Which agent is expected to receive the packet?
 	PacketHeader() :
 		packetType(PacketType::Last),
 		srcAgentId(NULL_AGENT_ID),
@@ -79,6 +111,64 @@ public:
 */
 using PacketUnregisterMCC = PacketRegisterMCC;
 
+/**
+ * Registrations (PacketType::RegisterMCCBatch) or unregistrations
+ * (PacketType::UnregisterMCCBatch) of several MCCs of the same host.
+ * The agent container coalesces the ones issued during a frame, so
+ * spawning many MCCs at once only takes a round trip.
+ */
+class PacketRegisterMCCBatch {
+public:
+	struct Entry {
+		AgentId agentId; // Which MCC?
+		uint16_t itemId; // Which item does it contribute?
+	};
+	std::vector<Entry> mccs;
+	void Read(InputMemoryStream &stream) {
+		uint32_t count;
+		stream.Read(count);
+		mccs.resize(count);
+		for (auto &mcc : mccs) {
+			stream.Read(mcc.agentId);
+			stream.Read(mcc.itemId);
+		}
+	}
+	void Write(OutputMemoryStream &stream) {
+		auto count = static_cast<uint32_t>(mccs.size());
+		stream.Write(count);
+		for (auto &mcc : mccs) {
+			stream.Write(mcc.agentId);
+			stream.Write(mcc.itemId);
+		}
+	}
+};
+
+using PacketUnregisterMCCBatch = PacketRegisterMCCBatch;
+
+/**
+ * Response to PacketRegisterMCCBatch. The node cluster turns it
+ * into a RegisterMCCAck for each of the agents.
+ */
+class PacketRegisterMCCBatchAck {
+public:
+	std::vector<AgentId> agentIds;
+	void Read(InputMemoryStream &stream) {
+		uint32_t count;
+		stream.Read(count);
+		agentIds.resize(count);
+		for (auto &agentId : agentIds) {
+			stream.Read(agentId);
+		}
+	}
+	void Write(OutputMemoryStream &stream) {
+		auto count = static_cast<uint32_t>(agentIds.size());
+		stream.Write(count);
+		for (auto agentId : agentIds) {
+			stream.Write(agentId);
+		}
+	}
+};
+
 /**
 * The information is the same required for PacketRegisterMCC so...
 */
@@ -94,7 +184,7 @@ class PacketReturnMCCsForItem {
 public:
 	std::vector<AgentLocation> mccAddresses;
 	void Read(InputMemoryStream &stream) {
-		uint16_t count;
+		uint32_t count;
 		stream.Read(count);
 		mccAddresses.resize(count);
 		for (auto &mccAddress : mccAddresses) {
@@ -102,7 +192,11 @@ public:
 		}
 	}
 	void Write(OutputMemoryStream &stream) {
-		auto count = static_cast<uint16_t>(mccAddresses.size());
+		Write(stream, mccAddresses);
+	}
+	// Used by the YellowPages to serialize its lists without copying them
+	static void Write(OutputMemoryStream &stream, const std::vector<AgentLocation> &mccAddresses) {
+		auto count = static_cast<uint32_t>(mccAddresses.size());
 		stream.Write(count);
 		for (auto &mccAddress : mccAddresses) {
 			mccAddress.Write(stream);
@@ -112,6 +206,53 @@ public:
 
 
 
+// Node cluster <-> YP
+
+/**
+ * A node cluster subscribes to an item to keep a local copy of
+ * its MCCs. The YP answers with a PacketSnapshotMCCsForItem and
+ * then pushes a PacketMCCDelta on each (un)registration, until
+ * the connection is closed.
+ */
+using PacketSubscribeMCCsForItem = PacketRegisterMCC;
+
+/**
+ * Initial list of MCCs sent to a new subscriber of the item.
+ */
+class PacketSnapshotMCCsForItem {
+public:
+	uint16_t itemId;
+	PacketReturnMCCsForItem mccs;
+	void Read(InputMemoryStream &stream) {
+		stream.Read(itemId);
+		mccs.Read(stream);
+	}
+	void Write(OutputMemoryStream &stream) {
+		stream.Write(itemId);
+		mccs.Write(stream);
+	}
+};
+
+/**
+ * MCC registered (PacketType::MCCRegistered) or unregistered
+ * (PacketType::MCCUnregistered) for an item with subscribers.
+ */
+class PacketMCCDelta {
+public:
+	uint16_t itemId;
+	AgentLocation mcc;
+	void Read(InputMemoryStream &stream) {
+		stream.Read(itemId);
+		mcc.Read(stream);
+	}
+	void Write(OutputMemoryStream &stream) {
+		stream.Write(itemId);
+		mcc.Write(stream);
+	}
+};
+
+
+
 // MCP <-> MCC
 
 class ResponseForNegotiation {
@@ -134,16 +275,19 @@ public:
 
 	uint16_t _requestedItemId;
 	uint16_t _contributedItemId;
+	uint16_t _searchDepth; // Depth of the MCP (bounds the deadline of the MCC)
 
 	void Read(InputMemoryStream &stream)
 	{
 		stream.Read(_requestedItemId);
 		stream.Read(_contributedItemId);
+		stream.Read(_searchDepth);
 	}
 	void Write(OutputMemoryStream &stream)
 	{
 		stream.Write(_requestedItemId);
 		stream.Write(_contributedItemId);
+		stream.Write(_searchDepth);
 	}
 
 };
@@ -0,0 +1,47 @@
+#include "SearchCache.h"
+
+
+void SearchCache::store(uint16_t requestedItemId, uint16_t contributedItemId, unsigned int depth, bool found)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	Entry &entry = _entries[makeKey(requestedItemId, contributedItemId, depth)];
+	entry.found = found;
+	entry.expiry = Clock::now() + std::chrono::milliseconds(SEARCH_CACHE_TTL_MILLIS);
+}
+
+bool SearchCache::knownToFail(uint16_t requestedItemId, uint16_t contributedItemId, unsigned int depth)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_lookups++;
+
+	// Failing with more depth left means failing with less too
+	const Clock::time_point now = Clock::now();
+	for (unsigned int d = 0; d <= depth; ++d)
+	{
+		auto it = _entries.find(makeKey(requestedItemId, contributedItemId, d));
+		if (it == _entries.end()) {
+			continue;
+		}
+		if (now >= it->second.expiry) {
+			_entries.erase(it);
+			continue;
+		}
+		if (!it->second.found) {
+			_hits++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void SearchCache::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_entries.clear();
+}
+
+uint64_t SearchCache::makeKey(uint16_t requestedItemId, uint16_t contributedItemId, unsigned int depth)
+{
+	return ((uint64_t)requestedItemId << 48) | ((uint64_t)contributedItemId << 32) | depth;
+}
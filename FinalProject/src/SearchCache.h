@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Globals.h"
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * Recent results of the sub-searches started by UCPs (child MCPs),
+ * shared by all the nodes of the process. Searches for the same
+ * (requested item, contributed item) pair that failed recently
+ * are answered right away instead of spawning the subtree again.
+ */
+class SearchCache
+{
+public:
+
+	// It records the result of a sub-search started at the given depth
+	// (it can be called from several threads)
+	void store(uint16_t requestedItemId, uint16_t contributedItemId, unsigned int depth, bool found);
+
+	// Whether the same sub-search failed within SEARCH_CACHE_TTL_MILLIS
+	// at this depth or a smaller one (with more depth left to search)
+	bool knownToFail(uint16_t requestedItemId, uint16_t contributedItemId, unsigned int depth);
+
+	void clear();
+
+	// Metrics
+	uint64_t lookups() const { return _lookups; }
+	uint64_t hits() const { return _hits; }
+
+private:
+
+	using Clock = std::chrono::steady_clock;
+
+	/** Result of a sub-search. */
+	struct Entry
+	{
+		bool found;
+		Clock::time_point expiry;
+	};
+
+	static uint64_t makeKey(uint16_t requestedItemId, uint16_t contributedItemId, unsigned int depth);
+
+	std::mutex _mutex; /**< UCPs of different nodes are updated in parallel. */
+	std::unordered_map<uint64_t, Entry> _entries; /**< Results by (requested, contributed, depth). */
+	uint64_t _lookups = 0;
+	uint64_t _hits = 0;
+};
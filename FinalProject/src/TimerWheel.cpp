@@ -0,0 +1,62 @@
+#include "TimerWheel.h"
+
+
+TimerWheel::TimerWheel() :
+	_startTime(Clock::now())
+{
+}
+
+void TimerWheel::schedule(AgentId agentId, uint32_t stateSerial, unsigned int delayMillis)
+{
+	// Rounded up, so timers never expire early
+	Timer timer;
+	timer.agentId = agentId;
+	timer.stateSerial = stateSerial;
+	timer.tick = currentTick() + (delayMillis + TICK_MILLIS - 1) / TICK_MILLIS + 1;
+
+	_slots[timer.tick % SLOT_COUNT].push_back(timer);
+	_timerCount++;
+}
+
+void TimerWheel::expire(std::vector<Timer> &expired)
+{
+	const uint64_t nowTick = currentTick();
+	if (nowTick <= _expiredTick) {
+		return;
+	}
+
+	// After a long frame every slot is visited once
+	const uint64_t firstTick = (nowTick - _expiredTick > SLOT_COUNT) ? nowTick - SLOT_COUNT + 1 : _expiredTick + 1;
+	for (uint64_t tick = firstTick; tick <= nowTick; ++tick)
+	{
+		// Timers of later turns of the wheel stay in the slot
+		std::vector<Timer> &slot = _slots[tick % SLOT_COUNT];
+		size_t kept = 0;
+		for (size_t i = 0; i < slot.size(); ++i)
+		{
+			if (slot[i].tick <= nowTick) {
+				expired.push_back(slot[i]);
+			} else {
+				slot[kept++] = slot[i];
+			}
+		}
+		_timerCount -= slot.size() - kept;
+		slot.resize(kept);
+	}
+
+	_expiredTick = nowTick;
+}
+
+void TimerWheel::clear()
+{
+	for (auto &slot : _slots) {
+		slot.clear();
+	}
+	_timerCount = 0;
+}
+
+uint64_t TimerWheel::currentTick() const
+{
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - _startTime);
+	return static_cast<uint64_t>(elapsed.count()) / TICK_MILLIS;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Globals.h"
+#include <chrono>
+#include <vector>
+
+/**
+ * Hashed timer wheel with the deadlines of the agent states. Timers
+ * are stored in the slot of their tick, so scheduling is constant
+ * time and each frame only visits the slots of the elapsed ticks.
+ * Timers are never removed: the ModuleAgentContainer ignores the
+ * ones whose agent changed its state since they were scheduled.
+ */
+class TimerWheel
+{
+public:
+
+	using Clock = std::chrono::steady_clock;
+
+	/** Deadline of a state of an agent. */
+	struct Timer
+	{
+		AgentId agentId;
+		uint32_t stateSerial; /**< Agent::stateSerial() when it was scheduled. */
+		uint64_t tick; /**< Tick of the deadline. */
+	};
+
+	TimerWheel();
+
+	// It schedules a timer expiring in the given milliseconds
+	void schedule(AgentId agentId, uint32_t stateSerial, unsigned int delayMillis);
+
+	// It moves the expired timers into the given vector
+	void expire(std::vector<Timer> &expired);
+
+	// It removes all the timers
+	void clear();
+
+	// Number of scheduled timers (expired or not)
+	size_t size() const { return _timerCount; }
+
+private:
+
+	static const unsigned int TICK_MILLIS = 50;
+	static const size_t SLOT_COUNT = 256; /**< Ticks of a turn of the wheel. */
+
+	// Ticks elapsed since the creation of the wheel
+	uint64_t currentTick() const;
+
+	Clock::time_point _startTime; /**< Time of tick 0. */
+	uint64_t _expiredTick = 0; /**< Last tick checked by expire(). */
+	std::vector<Timer> _slots[SLOT_COUNT]; /**< Timers by tick % SLOT_COUNT. */
+	size_t _timerCount = 0;
+};
@@ -9,20 +9,30 @@ enum State
 	ST_NEGOTIATION_CLOSED
 };
 
-UCC::UCC(Node *node, uint16_t _contributedItemId, uint16_t _constraintItemId) :
+UCC::UCC(Node *node, uint16_t _contributedItemId, uint16_t _constraintItemId, unsigned int _searchDepth) :
 	Agent(node)
 {
 	// TODO: Save input parameters
 	contributedItemId = _contributedItemId;
 	constraintItemId = _constraintItemId;
+	searchDepth = _searchDepth;
 }
 
 UCC::~UCC()
 {
 }
 
+void UCC::start()
+{
+	setStateTimeout(negotiationStateTimeoutMillis(searchDepth));
+}
+
 void UCC::stop()
 {
+	// Stopped in the middle of a negotiation (e.g. the MCC was stopped)
+	if (state() != ST_NEGOTIATION_CLOSED) {
+		cancelNegotiation();
+	}
 	destroy();
 }
 
@@ -47,9 +57,12 @@ void UCC::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 			oPacketBody.Id = constraintItemId;
 			oPacketBody.Write(ostream);
 			iLog << "UCC::Sending ConstraintRequest";
-			socket->SendPacket(ostream.GetBufferPtr(), ostream.GetSize());
+			sendPacketToSocket(socket, ostream);
 
+			_ucpSocket = socket;
+			_ucpAgentId = packetHeader.srcAgentId;
 			setState(ST_WAITING_CONSTRAINT);
+			setStateTimeout(negotiationStateTimeoutMillis(searchDepth));
 		}
 		else {
 			wLog << "UCC::PacketReceived() - Unexpected Item Request";
@@ -74,7 +87,7 @@ void UCC::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 			OutputMemoryStream ostream;
 			oPacketHeader.Write(ostream);
 			iLog << "UCC::Sending ConstraintAck";
-			socket->SendPacket(ostream.GetBufferPtr(), ostream.GetSize());
+			sendPacketToSocket(socket, ostream);
 
 			setState(ST_NEGOTIATION_CLOSED);
 		}
@@ -82,11 +95,48 @@ void UCC::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 			wLog << "UCC::PacketReceived() - Unexpected Constraint Result";
 		}
 		break;
+	case PacketType::CancelNegotiation:
+		// The UCP was stopped
+		if (state() != ST_NEGOTIATION_CLOSED) {
+			_ucpSocket = nullptr;
+			negociation_success = false;
+			setState(ST_NEGOTIATION_CLOSED);
+		}
+		break;
+
 	default:
 		wLog << "OnPacketReceived() - Unexpected PacketType.";
 	}
 }
 
+void UCC::OnTimeout()
+{
+	if (state() != ST_NEGOTIATION_CLOSED)
+	{
+		wLog << "UCC::Negotiation timed out";
+		cancelNegotiation();
+		negociation_success = false;
+		setState(ST_NEGOTIATION_CLOSED);
+	}
+}
+
+void UCC::cancelNegotiation()
+{
+	if (_ucpSocket == nullptr) {
+		return;
+	}
+
+	PacketHeader oPacketHeader;
+	oPacketHeader.packetType = PacketType::CancelNegotiation;
+	oPacketHeader.srcAgentId = id();
+	oPacketHeader.dstAgentId = _ucpAgentId;
+	OutputMemoryStream ostream;
+	oPacketHeader.Write(ostream);
+	sendPacketToSocket(_ucpSocket, ostream);
+
+	_ucpSocket = nullptr;
+}
+
 bool UCC::NegotiationSuccess()
 {
 	bool ret = false;
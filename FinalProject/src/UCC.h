@@ -7,14 +7,16 @@ class UCC :
 public:
 
 	// Constructor and destructor
-	UCC(Node *node, uint16_t contributedItemId, uint16_t constraintItemId);
+	UCC(Node *node, uint16_t contributedItemId, uint16_t constraintItemId, unsigned int searchDepth);
 	~UCC();
 
 	// Agent methods
+	void start() override;
 	void update() override { }
 	void stop() override;
 	UCC* asUCC() override { return this; }
 	void OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader, InputMemoryStream &stream) override;
+	void OnTimeout() override;
 	bool NegotiationSuccess();
 	bool NegotiationClosed();
 	
@@ -22,5 +24,14 @@ public:
 	//parameters
 	uint16_t contributedItemId;
 	uint16_t constraintItemId;
+	unsigned int searchDepth; // Depth of the UCP it answers
+
+private:
+
+	// It tells the UCP that this negotiation is over
+	void cancelNegotiation();
+
+	TCPSocketPtr _ucpSocket; /**< Connection of the UCP (once it requested the item). */
+	AgentId _ucpAgentId = NULL_AGENT_ID; /**< UCP negotiating with this UCC. */
 };
 
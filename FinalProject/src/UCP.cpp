@@ -2,6 +2,7 @@
 #include "MCP.h"
 #include "Application.h"
 #include "ModuleAgentContainer.h"
+#include "ModuleNodeCluster.h"
 
 
 // TODO: Make an enum with the states
@@ -37,10 +38,12 @@ void UCP::update()
 		success = -1;
 		RequestForItem();
 		setState(ST_ITEM_REQUEST);
+		setStateTimeout(negotiationStateTimeoutMillis(searchDepth));
 		break;
 
 	case ST_CONSTRAINT_CALCULATING:
 		if (MCP->negotiationFinished()) {
+			App->modNodeCluster->searchCache().store(MCP->requestedItemId(), contributedItemId, searchDepth, MCP->negotiationAgreement());
 			if (MCP->negotiationAgreement()) {
 				ResultConstraint(true);
 				success = true;
@@ -51,6 +54,7 @@ void UCP::update()
 				success = false;
 			}
 			setState(ST_CONSTRAINT_SENT);
+			setStateTimeout(negotiationStateTimeoutMillis(searchDepth));
 		}
 		break;
 	default:;
@@ -59,7 +63,12 @@ void UCP::update()
 
 void UCP::stop()
 {
-	// TODO: Destroy search hierarchy below this agent
+	// The UCC is released if the negotiation did not finish
+	if (state() != ST_INIT && state() != ST_NEGOTIATION_CLOSED) {
+		CancelNegotiation();
+	}
+
+	// Cancellation goes down the search hierarchy (MCP->UCP->...)
 	DestroyChildMCP();
 	destroy();
 }
@@ -77,19 +86,38 @@ void UCP::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 			success = true;
 			ResultConstraint(success);
 			setState(ST_CONSTRAINT_SENT);
+			setStateTimeout(negotiationStateTimeoutMillis(searchDepth));
 		}
 		else
 		{
-			if (searchDepth >= MAX_SEARCH_DEPTH) {
+			if (searchDepth >= g_Config.maxSearchDepth) {
 				success = false;
 				ResultConstraint(success);
 				wLog << "Max Depth Reached";
 				setState(ST_CONSTRAINT_SENT);
+				setStateTimeout(negotiationStateTimeoutMillis(searchDepth));
+			}
+			else if (App->modNodeCluster->searchCache().knownToFail(packetbody.Id, contributedItemId, searchDepth)) {
+				// The same subtree was searched in vain a moment ago
+				success = false;
+				ResultConstraint(success);
+				iLog << "UCP::Constraint known to be unresolvable";
+				setState(ST_CONSTRAINT_SENT);
+				setStateTimeout(negotiationStateTimeoutMillis(searchDepth));
 			}
 			else {
 				iLog << "UCP::Constraint Unresolved";
 				createChildMCP(packetbody.Id);
-				setState(ST_CONSTRAINT_CALCULATING);
+				if (MCP != nullptr) {
+					setState(ST_CONSTRAINT_CALCULATING);
+				}
+				else {
+					// No agent could be created to search the constraint
+					success = false;
+					ResultConstraint(success);
+					setState(ST_CONSTRAINT_SENT);
+					setStateTimeout(negotiationStateTimeoutMillis(searchDepth));
+				}
 			}
 		}
 		break;
@@ -104,11 +132,43 @@ void UCP::OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader
 		}
 		break;
 
+	case PacketType::CancelNegotiation:
+		// The UCC (or its MCC) was stopped
+		if (state() != ST_NEGOTIATION_CLOSED) {
+			iLog << "UCP::Negotiation cancelled";
+			DestroyChildMCP();
+			success = false;
+			setState(ST_NEGOTIATION_CLOSED);
+		}
+		break;
+
 	default:
 		wLog << "OnPacketReceived() - Unexpected PacketType.";
 	}
 }
 
+void UCP::OnTimeout()
+{
+	switch (state())
+	{
+	case ST_ITEM_REQUEST:
+		// The UCC did not ask for the constraint
+		wLog << "UCP::Item request timed out";
+		CancelNegotiation();
+		success = false;
+		setState(ST_NEGOTIATION_CLOSED);
+		break;
+
+	case ST_CONSTRAINT_SENT:
+		// The ack got lost, but the result was already sent
+		wLog << "UCP::Constraint ack timed out";
+		setState(ST_NEGOTIATION_CLOSED);
+		break;
+
+	default:;
+	}
+}
+
 bool UCP::RequestForItem()
 {
 	PacketHeader packethead;
@@ -146,6 +206,19 @@ bool UCP::ResultConstraint(bool result)
 	return sendPacketToAgent(LocationUCC.hostIP, LocationUCC.hostPort, stream);
 }
 
+bool UCP::CancelNegotiation()
+{
+	PacketHeader packethead;
+	packethead.packetType = PacketType::CancelNegotiation;
+	packethead.dstAgentId = LocationUCC.agentId;
+	packethead.srcAgentId = this->id();
+
+	OutputMemoryStream stream;
+	packethead.Write(stream);
+
+	return sendPacketToAgent(LocationUCC.hostIP, LocationUCC.hostPort, stream);
+}
+
 void UCP::createChildMCP(uint16_t newRequestedId)
 {
 	if (MCP != nullptr)
@@ -19,6 +19,7 @@ public:
 	void stop() override;
 	UCP* asUCP() override { return this; }
 	void OnPacketReceived(TCPSocketPtr socket, const PacketHeader &packetHeader, InputMemoryStream &stream) override;
+	void OnTimeout() override;
 
 	bool success = false;
 	// TODO
@@ -32,6 +33,7 @@ public:
 	//new functions
 	bool RequestForItem();
 	bool ResultConstraint(bool result);
+	bool CancelNegotiation();
 	void createChildMCP(uint16_t newRequestedId);
 	void DestroyChildMCP();
 
@@ -0,0 +1,23 @@
+#pragma once
+#include "Globals.h"
+
+// YellowPages cluster layout /////////////////////////////////////////
+
+/** It returns the partition of the YellowPages storing the given item. */
+inline int yellowPagesPartition(uint16_t itemId)
+{
+	return itemId % g_Config.ypPartitions;
+}
+
+/**
+ * It returns the listen port of a YellowPages process. Processes are
+ * numbered replica by replica (all the partitions of replica 0 first),
+ * so they can run on the same host for testing.
+ */
+inline uint16_t yellowPagesPort(int partition, int replica)
+{
+	if (g_Config.ypPartitions * g_Config.ypReplicas == 1) {
+		return LISTEN_PORT_YP;
+	}
+	return static_cast<uint16_t>(LISTEN_PORT_YP_CLUSTER + replica * g_Config.ypPartitions + partition);
+}
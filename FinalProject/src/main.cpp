@@ -1,11 +1,95 @@
 #include "Application.h"
+#include "Globals.h"
 #include "Log.h"
+#include <algorithm>
+#include <string>
 
 // Start the application without the black console in the background
+// (the Headless configuration, with HEADLESS_BUILD, is a console program
+// without the GUI modules, so benchmarks can be scripted)
+#ifndef HEADLESS_BUILD
 #pragma comment(linker, "/SUBSYSTEM:windows /ENTRY:mainCRTStartup")
+#endif
 
 Application * App = nullptr;
 
+SimulationConfig g_Config;
+
+// It reads the options of the simulation, e.g.:
+//   --nodes 1000 --items 20000 --depth 4 --seed 7
+//   --headless --script load.txt --frames 5000 --log run.log
+//   --headless --yellow-pages 0 0
+//   --yp-cluster 4 2 (in every process of the run)
+//   --benchmark results.jsonl --nodes 100 --items 200
+//   --headless --metrics metrics.jsonl
+static void parseArguments(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string option = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		const unsigned int value = hasValue ? (unsigned int)strtoul(argv[i + 1], nullptr, 10) : 0U;
+
+		if (option == "--headless") {
+			g_Config.headless = true;
+		} else if (option == "--yellow-pages" && i + 2 < argc) {
+			g_Config.headlessYellowPages = true;
+			g_Config.ypPartition = atoi(argv[++i]);
+			g_Config.ypReplica = atoi(argv[++i]);
+		} else if (option == "--yp-cluster" && i + 2 < argc) {
+			g_Config.ypPartitions = std::max(atoi(argv[++i]), 1);
+			g_Config.ypReplicas = std::max(atoi(argv[++i]), 1);
+		} else if (!hasValue) {
+			wLog << "Missing value of the option " << option;
+		} else if (option == "--items" && value > 0) {
+			g_Config.maxItems = std::min(value, MAX_CATALOGUE_ITEMS);
+			++i;
+		} else if (option == "--nodes" && value > 0) {
+			g_Config.maxNodes = value;
+			++i;
+		} else if (option == "--depth") {
+			g_Config.maxSearchDepth = value;
+			++i;
+		} else if (option == "--seed") {
+			g_Config.randomSeed = value;
+			++i;
+		} else if (option == "--frames") {
+			g_Config.frames = value;
+			++i;
+		} else if (option == "--script") {
+			g_Config.scriptPath = argv[++i];
+		} else if (option == "--log") {
+			g_Config.logPath = argv[++i];
+		} else if (option == "--benchmark") {
+			g_Config.headless = true;
+			g_Config.benchmarkReportPath = argv[++i];
+		} else if (option == "--metrics") {
+			g_Config.metricsPath = argv[++i];
+		} else {
+			wLog << "Unknown option " << option;
+			++i;
+		}
+	}
+
+#ifdef HEADLESS_BUILD
+	// There is no window to open
+	g_Config.headless = true;
+#endif
+
+	if (g_Config.ypPartition >= g_Config.ypPartitions || g_Config.ypReplica >= g_Config.ypReplicas) {
+		wLog << "YellowPages " << g_Config.ypPartition << " " << g_Config.ypReplica << " is not in the cluster (see --yp-cluster)";
+	}
+
+	// Benchmarks are reproducible unless a seed is given
+	if (!g_Config.benchmarkReportPath.empty() && g_Config.randomSeed == 0) {
+		g_Config.randomSeed = 1;
+	}
+
+	if (!g_Config.logPath.empty() && !g_Log.enableFileOutput(g_Config.logPath)) {
+		eLog << "Could not open the log file " << g_Config.logPath;
+	}
+}
+
 enum class MainState
 {
 	Create,
@@ -22,6 +106,8 @@ int main(int argc, char **argv)
 
 	MainState state = MainState::Create;
 
+	parseArguments(argc, argv);
+
 	while (state != MainState::Exit)
 	{
 		switch (state)
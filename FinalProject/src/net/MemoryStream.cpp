@@ -33,3 +33,15 @@ void InputMemoryStream::Read(void *outData, size_t inByteCount)
 	std::memcpy(outData, mBuffer + mHead, inByteCount);
 	mHead = resultHead;
 }
+
+void InputMemoryStream::SetView(const char *inData, uint32_t inSize)
+{
+	if (mOwnsBuffer)
+	{
+		std::free(mBuffer);
+		mOwnsBuffer = false;
+	}
+	mBuffer = const_cast<char*>(inData);
+	mCapacity = inSize;
+	mHead = 0;
+}
@@ -18,6 +18,10 @@ constexpr Endianness PLATFORM_ENDIANNESS = Endianness::LittleEndian;
 // Minimum IP and TCP header sizes are 20 bytes each
 constexpr uint32_t DEFAULT_STREAM_SIZE = 1460;
 
+// Default limit for the size of a single framed packet received by a
+// TCPSocket (larger frames are considered a protocol error)
+constexpr uint32_t DEFAULT_MAX_PACKET_SIZE = 1024 * 1024;
+
 class OutputMemoryStream
 {
 public:
@@ -99,12 +103,20 @@ public:
 
 	// Constructor
 	InputMemoryStream(uint32_t inSize = DEFAULT_STREAM_SIZE) :
-		mBuffer(static_cast<char*>(std::malloc(inSize))), mCapacity(inSize), mHead(0)
+		mBuffer(static_cast<char*>(std::malloc(inSize))), mCapacity(inSize), mHead(0), mOwnsBuffer(true)
+	{ }
+
+	// View constructor: reads from external memory without copying nor owning it
+	InputMemoryStream(const char *inData, uint32_t inSize) :
+		mBuffer(const_cast<char*>(inData)), mCapacity(inSize), mHead(0), mOwnsBuffer(false)
 	{ }
 
 	// Destructor
 	~InputMemoryStream()
-	{ std::free(mBuffer); }
+	{ if (mOwnsBuffer) std::free(mBuffer); }
+
+	// It turns this stream into a view of external memory
+	void SetView(const char *inData, uint32_t inSize);
 
 	// Get pointer to the data in the stream
 	char *GetBufferPtr() const { return mBuffer; }
@@ -167,6 +179,7 @@ private:
 	char *mBuffer;
 	uint32_t mCapacity;
 	uint32_t mHead;
+	bool mOwnsBuffer;
 };
 
 #endif // MEMORY_STREAM_H
@@ -0,0 +1,69 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+/**
+ * Unbounded lock-free queue for any number of producer threads and a
+ * single consumer thread (linked list with a dummy node, pushing only
+ * takes an atomic exchange). Used as the packet inbox of the agents.
+ */
+template< typename T >
+class MpscQueue
+{
+public:
+
+	MpscQueue() :
+		mHead(new Node), mTail(mHead.load(std::memory_order_relaxed))
+	{ }
+
+	~MpscQueue()
+	{
+		T item;
+		while (TryPop(item)) { }
+		delete mTail;
+	}
+
+	MpscQueue(const MpscQueue &) = delete;
+	MpscQueue &operator=(const MpscQueue &) = delete;
+
+	// Producer side (any thread)
+	void Push(T &&inItem)
+	{
+		Node *node = new Node;
+		node->value = std::move(inItem);
+		Node *prev = mHead.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	// Consumer side: it returns false if the queue is empty
+	// (or if the last push is still linking its node)
+	bool TryPop(T &outItem)
+	{
+		Node *next = mTail->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+		{
+			return false;
+		}
+		outItem = std::move(next->value);
+		next->value = T();
+		delete mTail;
+		mTail = next; // The popped node becomes the dummy node
+		return true;
+	}
+
+private:
+
+	struct Node
+	{
+		Node() : next(nullptr) { }
+		std::atomic<Node*> next;
+		T value;
+	};
+
+	std::atomic<Node*> mHead; // Last pushed node
+	Node *mTail; // Dummy node, followed by the first item
+};
+
+#endif // MPSC_QUEUE_H
@@ -0,0 +1,95 @@
+#ifndef MPSC_RING_BUFFER_H
+#define MPSC_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * Bounded lock-free queue for any number of producer threads and a
+ * single consumer thread. Unlike MpscQueue, the slots are allocated
+ * once, so pushing only takes a compare-and-swap (each slot has a
+ * sequence number telling whether it is free or filled for a lap).
+ * Used as the message queue of the log backend.
+ */
+template< typename T, size_t Capacity >
+class MpscRingBuffer
+{
+	static_assert((Capacity & (Capacity - 1)) == 0 && Capacity > 1, "Capacity must be a power of two");
+
+public:
+
+	MpscRingBuffer() :
+		mSlots(new Slot[Capacity]), mEnqueuePos(0), mDequeuePos(0)
+	{
+		for (size_t i = 0; i < Capacity; ++i)
+		{
+			mSlots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpscRingBuffer(const MpscRingBuffer &) = delete;
+	MpscRingBuffer &operator=(const MpscRingBuffer &) = delete;
+
+	// Producer side (any thread): it returns false if the buffer is full
+	bool TryPush(T &&inItem)
+	{
+		size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Slot &slot = mSlots[pos & (Capacity - 1)];
+			const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+			if (diff == 0)
+			{
+				// The slot is free in this lap, try to claim it
+				if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					slot.value = std::move(inItem);
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false; // Not consumed yet since the previous lap
+			}
+			else
+			{
+				pos = mEnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Consumer side: it returns false if the buffer is empty
+	// (or if the next push is still writing its slot)
+	bool TryPop(T &outItem)
+	{
+		Slot &slot = mSlots[mDequeuePos & (Capacity - 1)];
+		const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if ((intptr_t)sequence - (intptr_t)(mDequeuePos + 1) < 0)
+		{
+			return false;
+		}
+		outItem = std::move(slot.value);
+		slot.sequence.store(mDequeuePos + Capacity, std::memory_order_release);
+		++mDequeuePos;
+		return true;
+	}
+
+private:
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<Slot[]> mSlots;
+	alignas(64) std::atomic<size_t> mEnqueuePos; // Next slot for the producers
+	alignas(64) size_t mDequeuePos; // Next slot for the consumer
+};
+
+#endif // MPSC_RING_BUFFER_H
@@ -12,18 +12,23 @@
 	#define s_addr S_un.S_addr
 #else
 	#include <sys/socket.h>
+	#include <sys/uio.h>
 	#include <netinet/in.h>
 	#include <sys/types.h>
 	#include <netdb.h>
 	#include <errno.h>
 	#include <fcntl.h>
 	#include <unistd.h>
+	#ifdef __linux__
+		#include <sys/epoll.h>
+	#endif
 	//typedef void* receiveBufer_t;
 	typedef int SOCKET;
 	const int NO_ERROR = 0;
 	const int INVALID_SOCKET = -1;
 	const int WSAECONNRESET = ECONNRESET;
 	const int WSAEWOULDBLOCK = EAGAIN;
+	const int WSAEINPROGRESS = EINPROGRESS;
 	const int SOCKET_ERROR = -1;
 #endif
 
@@ -37,14 +42,23 @@
 #include <list>
 #include <set>
 #include <cassert>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <deque>
 
 #include "StringUtils.h"
 #include "SocketAddress.h"
 #include "UDPSocket.h"
-#include "TCPSocket.h"
-#include "SocketUtil.h"
 #include "ByteSwap.h"
 #include "MemoryStream.h"
+#include "RingBuffer.h"
+#include "TCPSocket.h"
+#include "SocketUtil.h"
+#include "SocketPoller.h"
 #include "TCPNetworkManager.h"
+#include "SpscQueue.h"
+#include "MpscQueue.h"
+#include "TCPIOThread.h"
 
 #endif // MULTIPLAYER_H
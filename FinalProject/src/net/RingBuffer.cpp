@@ -0,0 +1,129 @@
+#include "RingBuffer.h"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm> // std::min, std::rotate
+#include <cassert>
+
+RingBuffer::~RingBuffer()
+{
+	std::free(mBuffer);
+}
+
+void RingBuffer::Reserve(size_t inFreeSpace)
+{
+	if (FreeSpace() < inFreeSpace)
+	{
+		size_t newCapacity = mCapacity > 0 ? mCapacity : 1024;
+		while (newCapacity - mSize < inFreeSpace)
+		{
+			newCapacity *= 2;
+		}
+		ReallocBuffer(newCapacity);
+	}
+}
+
+void RingBuffer::Write(const void *inData, size_t inByteCount)
+{
+	Reserve(inByteCount);
+
+	// Copy in (at most) two chunks, before and after the end of the buffer
+	const char *data = static_cast<const char*>(inData);
+	const size_t firstChunk = std::min(inByteCount, ContiguousWriteSize());
+	std::memcpy(WritePtr(), data, firstChunk);
+	mSize += firstChunk;
+	std::memcpy(WritePtr(), data + firstChunk, inByteCount - firstChunk);
+	mSize += inByteCount - firstChunk;
+}
+
+void RingBuffer::Peek(void *outData, size_t inByteCount, size_t inOffset) const
+{
+	assert(inOffset + inByteCount <= mSize && "RingBuffer::Peek() - trying to read more data than available.");
+	if (inByteCount == 0)
+	{
+		return;
+	}
+
+	char *data = static_cast<char*>(outData);
+	const size_t start = (mHead + inOffset) & (mCapacity - 1);
+	const size_t firstChunk = std::min(inByteCount, mCapacity - start);
+	std::memcpy(data, mBuffer + start, firstChunk);
+	std::memcpy(data + firstChunk, mBuffer, inByteCount - firstChunk);
+}
+
+void RingBuffer::Consume(size_t inByteCount)
+{
+	assert(inByteCount <= mSize && "RingBuffer::Consume() - trying to consume more data than available.");
+
+	mSize -= inByteCount;
+	mHead = (mSize == 0) ? 0 : ((mHead + inByteCount) & (mCapacity - 1));
+}
+
+size_t RingBuffer::ContiguousReadSize() const
+{
+	return std::min(mSize, mCapacity - mHead);
+}
+
+int RingBuffer::ReadSegments(const char *outData[2], size_t outSizes[2]) const
+{
+	if (mSize == 0)
+	{
+		return 0;
+	}
+
+	outData[0] = ReadPtr();
+	outSizes[0] = ContiguousReadSize();
+	if (outSizes[0] == mSize)
+	{
+		return 1;
+	}
+
+	outData[1] = mBuffer;
+	outSizes[1] = mSize - outSizes[0];
+	return 2;
+}
+
+size_t RingBuffer::ContiguousWriteSize() const
+{
+	if (mSize == mCapacity)
+	{
+		return 0;
+	}
+
+	// Free space ends either at the end of the buffer or at the head
+	const size_t tail = (mHead + mSize) & (mCapacity - 1);
+	return (tail >= mHead) ? mCapacity - tail : mHead - tail;
+}
+
+void RingBuffer::Commit(size_t inByteCount)
+{
+	assert(inByteCount <= ContiguousWriteSize() && "RingBuffer::Commit() - more data than free space.");
+	mSize += inByteCount;
+}
+
+const char *RingBuffer::Linearize(size_t inByteCount)
+{
+	assert(inByteCount <= mSize && "RingBuffer::Linearize() - trying to access more data than available.");
+
+	if (mHead + inByteCount > mCapacity)
+	{
+		std::rotate(mBuffer, mBuffer + mHead, mBuffer + mCapacity);
+		mHead = 0;
+	}
+	return mBuffer + mHead;
+}
+
+void RingBuffer::ReallocBuffer(size_t inNewCapacity)
+{
+	char *newBuffer = static_cast<char*>(std::malloc(inNewCapacity));
+	assert(newBuffer != nullptr && "RingBuffer::ReallocBuffer() - std::malloc() failed.");
+
+	if (mSize > 0)
+	{
+		Peek(newBuffer, mSize);
+	}
+	std::free(mBuffer);
+
+	mBuffer = newBuffer;
+	mCapacity = inNewCapacity;
+	mHead = 0;
+}
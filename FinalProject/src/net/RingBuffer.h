@@ -0,0 +1,69 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <cstddef>
+
+/**
+ * Growable circular byte buffer used by TCPSocket to accumulate
+ * incoming and outgoing data without compacting it after each use.
+ * The capacity is always a power of two.
+ */
+class RingBuffer
+{
+public:
+
+	// Constructor and destructor
+	RingBuffer() :
+		mBuffer(nullptr), mCapacity(0), mHead(0), mSize(0)
+	{ }
+
+	~RingBuffer();
+
+	// Size information
+	size_t Size() const { return mSize; }
+	size_t Capacity() const { return mCapacity; }
+	size_t FreeSpace() const { return mCapacity - mSize; }
+	bool Empty() const { return mSize == 0; }
+
+	// It grows the buffer (if needed) to have at least inFreeSpace bytes free
+	void Reserve(size_t inFreeSpace);
+
+	// It appends data at the end of the buffer (growing it if needed)
+	void Write(const void *inData, size_t inByteCount);
+
+	// It copies data from the buffer without consuming it
+	void Peek(void *outData, size_t inByteCount, size_t inOffset = 0) const;
+
+	// It discards data from the beginning of the buffer
+	void Consume(size_t inByteCount);
+
+	// Contiguous data at the beginning of the buffer
+	const char *ReadPtr() const { return mBuffer + mHead; }
+	size_t ContiguousReadSize() const;
+
+	// Data split in (at most) two chunks, before and after the end of the
+	// buffer, to be read in a single scatter/gather operation
+	int ReadSegments(const char *outData[2], size_t outSizes[2]) const;
+
+	// Contiguous free space at the end of the buffer (to be filled
+	// externally, e.g. with recv(), and confirmed with Commit())
+	char *WritePtr() { return mBuffer + ((mHead + mSize) & (mCapacity - 1)); }
+	size_t ContiguousWriteSize() const;
+	void Commit(size_t inByteCount);
+
+	// It makes the first inByteCount bytes contiguous in memory, which
+	// only needs moving data when they wrap around the end of the buffer
+	const char *Linearize(size_t inByteCount);
+
+private:
+
+	// Resize the buffer (data is moved to the beginning)
+	void ReallocBuffer(size_t inNewCapacity);
+
+	char *mBuffer;
+	size_t mCapacity;
+	size_t mHead;
+	size_t mSize;
+};
+
+#endif // RING_BUFFER_H
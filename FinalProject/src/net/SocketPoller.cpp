@@ -0,0 +1,139 @@
+#include "Net.h"
+
+std::unique_ptr<SocketPoller> SocketPoller::Create(SocketPollerType inType)
+{
+#ifdef __linux__
+	if (inType == SocketPollerType::Default || inType == SocketPollerType::Epoll)
+	{
+		return std::unique_ptr<SocketPoller>(new EpollSocketPoller());
+	}
+#endif
+	return std::unique_ptr<SocketPoller>(new SelectSocketPoller());
+}
+
+
+// SelectSocketPoller //////////////////////////////////////////////////
+
+int SelectSocketPoller::Poll(
+	const std::vector<TCPSocketPtr> &inSockets,
+	std::vector<TCPSocketPtr> &outReadable,
+	std::vector<TCPSocketPtr> &outWritable,
+	int timeoutMillis)
+{
+	// Preselect sockets for reading and writing
+	mPotentiallyReadable.clear();
+	mPotentiallyWritable.clear();
+	mConnecting.clear();
+	for (auto &socket : inSockets)
+	{
+		if (!socket->IsDisconnected())
+		{
+			mPotentiallyReadable.push_back(socket);
+			if (socket->HasOutgoingData() || socket->IsConnecting())
+			{
+				mPotentiallyWritable.push_back(socket);
+			}
+			if (socket->IsConnecting())
+			{
+				mConnecting.push_back(socket);
+			}
+		}
+	}
+
+	// Select readable and writable sockets
+	// Failed connections are only reported in the except set on Windows
+	mFailedConnections.clear();
+	int result = SocketUtil::Select(
+		&mPotentiallyReadable, &outReadable,
+		&mPotentiallyWritable, &outWritable,
+		mConnecting.empty() ? nullptr : &mConnecting, &mFailedConnections,
+		timeoutMillis);
+	outWritable.insert(outWritable.end(), mFailedConnections.begin(), mFailedConnections.end());
+	return result;
+}
+
+
+// EpollSocketPoller ///////////////////////////////////////////////////
+
+#ifdef __linux__
+
+EpollSocketPoller::EpollSocketPoller() :
+	mEpoll(epoll_create1(EPOLL_CLOEXEC)),
+	mEvents(256)
+{
+	if (mEpoll < 0)
+	{
+		SocketUtil::ReportError("EpollSocketPoller::EpollSocketPoller");
+	}
+}
+
+EpollSocketPoller::~EpollSocketPoller()
+{
+	if (mEpoll >= 0)
+	{
+		close(mEpoll);
+	}
+}
+
+void EpollSocketPoller::Add(const TCPSocketPtr &inSocket)
+{
+	// Edge-triggered mode requires draining sockets until they would block
+	inSocket->SetNonBlockingMode(true);
+
+	epoll_event event;
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.ptr = inSocket.get();
+	if (epoll_ctl(mEpoll, EPOLL_CTL_ADD, inSocket->mSocket, &event) < 0)
+	{
+		SocketUtil::ReportError("EpollSocketPoller::Add");
+	}
+}
+
+void EpollSocketPoller::Remove(const TCPSocketPtr &inSocket)
+{
+	epoll_event event = {}; // Ignored, but required by kernels before 2.6.9
+	epoll_ctl(mEpoll, EPOLL_CTL_DEL, inSocket->mSocket, &event);
+}
+
+int EpollSocketPoller::Poll(
+	const std::vector<TCPSocketPtr> &, // The registered sockets are known by the epoll instance
+	std::vector<TCPSocketPtr> &outReadable,
+	std::vector<TCPSocketPtr> &outWritable,
+	int timeoutMillis)
+{
+	const int eventCount = epoll_wait(mEpoll, mEvents.data(), (int)mEvents.size(), timeoutMillis);
+	if (eventCount < 0)
+	{
+		if (errno != EINTR)
+		{
+			SocketUtil::ReportError("EpollSocketPoller::Poll");
+		}
+		return 0;
+	}
+
+	for (int i = 0; i < eventCount; ++i)
+	{
+		const epoll_event &event = mEvents[i];
+		TCPSocketPtr socket = static_cast<TCPSocket*>(event.data.ptr)->shared_from_this();
+
+		// Hang-ups and errors are reported by the next read on the socket
+		if (event.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+		{
+			outReadable.push_back(socket);
+		}
+		if (event.events & EPOLLOUT)
+		{
+			outWritable.push_back(socket);
+		}
+	}
+
+	// Grow the event array if it was not enough to hold all ready sockets
+	if (eventCount == (int)mEvents.size())
+	{
+		mEvents.resize(mEvents.size() * 2);
+	}
+
+	return eventCount;
+}
+
+#endif // __linux__
@@ -0,0 +1,113 @@
+#ifndef SOCKET_POLLER_H
+#define SOCKET_POLLER_H
+
+/**
+ * Backends available to wait for socket readiness.
+ */
+enum class SocketPollerType
+{
+	Default, // Best backend available in the current platform
+	Select,  // Portable select(), level-triggered
+	Epoll    // Linux epoll(), edge-triggered
+};
+
+/**
+ * Interface used by the TCPNetworkManager to wait for socket readiness.
+ * Sockets are registered once when they enter the manager and unregistered
+ * when they leave it, so backends can keep their own kernel-side state.
+ */
+class SocketPoller
+{
+public:
+
+	virtual ~SocketPoller() { }
+
+	// It creates the requested backend (or the default one if not available)
+	static std::unique_ptr<SocketPoller> Create(SocketPollerType inType);
+
+	// Socket registration
+	virtual void Add(const TCPSocketPtr &inSocket) = 0;
+	virtual void Remove(const TCPSocketPtr &inSocket) = 0;
+
+	// It waits for sockets to be ready and fills the output vectors.
+	// inSockets contains all the registered sockets (level-triggered
+	// backends need them, edge-triggered backends can ignore them).
+	virtual int Poll(
+		const std::vector<TCPSocketPtr> &inSockets,
+		std::vector<TCPSocketPtr> &outReadable,
+		std::vector<TCPSocketPtr> &outWritable,
+		int timeoutMillis) = 0;
+
+	// Edge-triggered backends notify each readiness change only once,
+	// so callers must drain sockets until they would block
+	virtual bool IsEdgeTriggered() const = 0;
+
+	// Name of the backend (for debugging purposes)
+	virtual const char *GetName() const = 0;
+};
+
+/**
+ * Portable backend based on SocketUtil::Select.
+ * It rescans all the registered sockets on each call.
+ */
+class SelectSocketPoller : public SocketPoller
+{
+public:
+
+	void Add(const TCPSocketPtr &) override { }
+	void Remove(const TCPSocketPtr &) override { }
+
+	int Poll(
+		const std::vector<TCPSocketPtr> &inSockets,
+		std::vector<TCPSocketPtr> &outReadable,
+		std::vector<TCPSocketPtr> &outWritable,
+		int timeoutMillis) override;
+
+	bool IsEdgeTriggered() const override { return false; }
+
+	const char *GetName() const override { return "select"; }
+
+private:
+
+	std::vector<TCPSocketPtr> mPotentiallyReadable;
+	std::vector<TCPSocketPtr> mPotentiallyWritable;
+	std::vector<TCPSocketPtr> mConnecting;
+	std::vector<TCPSocketPtr> mFailedConnections;
+};
+
+#ifdef __linux__
+
+/**
+ * Edge-triggered epoll backend.
+ * The cost of each call scales with the number of ready sockets,
+ * not with the number of registered ones.
+ */
+class EpollSocketPoller : public SocketPoller
+{
+public:
+
+	EpollSocketPoller();
+	~EpollSocketPoller();
+
+	void Add(const TCPSocketPtr &inSocket) override;
+	void Remove(const TCPSocketPtr &inSocket) override;
+
+	int Poll(
+		const std::vector<TCPSocketPtr> &inSockets,
+		std::vector<TCPSocketPtr> &outReadable,
+		std::vector<TCPSocketPtr> &outWritable,
+		int timeoutMillis) override;
+
+	bool IsEdgeTriggered() const override { return true; }
+
+	const char *GetName() const override { return "epoll"; }
+
+private:
+
+	int mEpoll;
+	std::vector<epoll_event> mEvents;
+};
+
+#endif // __linux__
+
+#endif // SOCKET_POLLER_H
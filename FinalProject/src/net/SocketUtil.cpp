@@ -81,6 +81,15 @@ TCPSocketPtr SocketUtil::CreateTCPSocket(SocketAddressFamily inFamily)
 	}
 }
 
+TCPSocketPtr SocketUtil::CreateLoopbackSocket(const SocketAddress &inRemoteAddress)
+{
+	// Marked as closed, so the destructor does not release any descriptor
+	TCPSocketPtr socket(new TCPSocket(INVALID_SOCKET));
+	socket->mFlags = TCPSocket::FlagClosed | TCPSocket::FlagLoopback;
+	socket->mRemoteAddress = inRemoteAddress;
+	return socket;
+}
+
 fd_set* SocketUtil::FillSetFromVector(fd_set& outSet, const std::vector< TCPSocketPtr >* inSockets, int& ioNaxNfds)
 {
 	if (inSockets)
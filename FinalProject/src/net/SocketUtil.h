@@ -29,6 +29,9 @@ public:
 	static UDPSocketPtr	CreateUDPSocket(SocketAddressFamily inFamily);
 	static TCPSocketPtr	CreateTCPSocket(SocketAddressFamily inFamily);
 
+	// Socket without descriptor, used as the endpoint of in-process packets
+	static TCPSocketPtr	CreateLoopbackSocket(const SocketAddress &inRemoteAddress);
+
 private:
 
 	static fd_set* FillSetFromVector(fd_set& outSet, const std::vector< TCPSocketPtr >* inSockets, int& ioNaxNfds);
@@ -0,0 +1,68 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one
+ * consumer thread. Used to exchange commands and events between the
+ * application thread and the network I/O threads.
+ */
+template< typename T >
+class SpscQueue
+{
+public:
+
+	// The capacity is rounded up to a power of two
+	explicit SpscQueue(size_t inCapacity = 1024) :
+		mHead(0), mTail(0)
+	{
+		size_t capacity = 1;
+		while (capacity < inCapacity)
+		{
+			capacity *= 2;
+		}
+		mSlots.resize(capacity);
+		mMask = capacity - 1;
+	}
+
+	// Producer side: it returns false if the queue is full
+	bool TryPush(T &&inItem)
+	{
+		const size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mHead.load(std::memory_order_acquire) > mMask)
+		{
+			return false;
+		}
+		mSlots[tail & mMask] = std::move(inItem);
+		mTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side: it returns false if the queue is empty
+	bool TryPop(T &outItem)
+	{
+		const size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mTail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		outItem = std::move(mSlots[head & mMask]);
+		mSlots[head & mMask] = T();
+		mHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+
+	std::vector<T> mSlots;
+	size_t mMask;
+
+	// Producer and consumer positions live in different cache lines
+	alignas(64) std::atomic<size_t> mHead; // Next slot to pop
+	alignas(64) std::atomic<size_t> mTail; // Next slot to push
+};
+
+#endif // SPSC_QUEUE_H
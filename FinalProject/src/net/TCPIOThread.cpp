@@ -0,0 +1,195 @@
+#include "Net.h"
+
+TCPIOThread::TCPIOThread(SocketPollerType pollerType, int connectTimeoutMillis, uint32_t maxPacketSize) :
+	TCPNetworkManager(pollerType),
+	mFinished(false),
+	mAbort(false)
+{
+	SetDelegate(this);
+	SetConnectTimeout(connectTimeoutMillis);
+	SetMaxPacketSize(maxPacketSize);
+}
+
+TCPIOThread::~TCPIOThread()
+{
+	// Nobody consumes the events anymore, so do not wait to deliver them
+	mAbort = true;
+	Join();
+}
+
+void TCPIOThread::Start()
+{
+	mThread = std::thread(&TCPIOThread::Run, this);
+}
+
+void TCPIOThread::RequestStop()
+{
+	Command command;
+	command.type = Command::Stop;
+	PostCommand(std::move(command));
+}
+
+void TCPIOThread::Join()
+{
+	if (mThread.joinable())
+	{
+		mThread.join();
+	}
+}
+
+void TCPIOThread::PostAddSocket(const TCPSocketPtr &socket)
+{
+	Command command;
+	command.type = Command::AddSocket;
+	command.socket = socket;
+	PostCommand(std::move(command));
+}
+
+void TCPIOThread::PostSendPacket(const TCPSocketPtr &socket, const void *data, size_t size)
+{
+	Command command;
+	command.type = Command::SendPacket;
+	command.socket = socket;
+	command.data.assign(static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	PostCommand(std::move(command));
+}
+
+void TCPIOThread::PostDisconnect(const TCPSocketPtr &socket)
+{
+	Command command;
+	command.type = Command::Disconnect;
+	command.socket = socket;
+	PostCommand(std::move(command));
+}
+
+void TCPIOThread::PostCommand(Command &&command)
+{
+	// Keep the order of the commands waiting for room
+	if (!mPendingCommands.empty() || !mCommands.TryPush(std::move(command)))
+	{
+		mPendingCommands.push_back(std::move(command));
+	}
+}
+
+void TCPIOThread::FlushCommands()
+{
+	while (!mPendingCommands.empty() && mCommands.TryPush(std::move(mPendingCommands.front())))
+	{
+		mPendingCommands.pop_front();
+	}
+}
+
+bool TCPIOThread::PopEvent(Event &event)
+{
+	return mEvents.TryPop(event);
+}
+
+void TCPIOThread::Run()
+{
+	bool running = true;
+	while (running && !mAbort)
+	{
+		running = HandleCommands();
+
+		// Short timeout so that new commands are picked up quickly
+		const int timeoutMillis = 1;
+		if (allSockets().empty())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMillis));
+		}
+		else
+		{
+			HandleSocketOperations(timeoutMillis);
+		}
+
+		FlushEvents();
+	}
+
+	if (!mAbort)
+	{
+		// Send pending data and notify the last disconnections
+		Finalize();
+		while (!mPendingEvents.empty() && !mAbort)
+		{
+			FlushEvents();
+			std::this_thread::yield();
+		}
+	}
+
+	mFinished = true;
+}
+
+bool TCPIOThread::HandleCommands()
+{
+	Command command;
+	while (mCommands.TryPop(command))
+	{
+		switch (command.type)
+		{
+		case Command::AddSocket:
+			AddSocket(command.socket);
+			break;
+		case Command::SendPacket:
+			command.socket->QueuePacket(command.data.data(), command.data.size());
+			break;
+		case Command::Disconnect:
+			command.socket->RequestDisconnect();
+			break;
+		case Command::Stop:
+			return false;
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+void TCPIOThread::PostEvent(Event::Type type, const TCPSocketPtr &socket)
+{
+	Event event;
+	event.type = type;
+	event.socket = socket;
+	mPendingEvents.push_back(std::move(event));
+	FlushEvents();
+}
+
+void TCPIOThread::FlushEvents()
+{
+	while (!mPendingEvents.empty() && mEvents.TryPush(std::move(mPendingEvents.front())))
+	{
+		mPendingEvents.pop_front();
+	}
+}
+
+void TCPIOThread::OnAccepted(TCPSocketPtr socket)
+{
+	// The application thread assigns the socket to an I/O thread
+	DetachSocket(socket);
+	PostEvent(Event::Accepted, socket);
+}
+
+void TCPIOThread::OnPacketReceived(TCPSocketPtr socket, InputMemoryStream &stream)
+{
+	// The packet is copied, the stream only lives until the next packet
+	Event event;
+	event.type = Event::PacketReceived;
+	event.socket = socket;
+	event.data.assign(stream.GetBufferPtr(), stream.GetBufferPtr() + stream.GetCapacity());
+	mPendingEvents.push_back(std::move(event));
+	FlushEvents();
+}
+
+void TCPIOThread::OnDisconnected(TCPSocketPtr socket)
+{
+	PostEvent(Event::Disconnected, socket);
+}
+
+void TCPIOThread::OnConnected(TCPSocketPtr socket)
+{
+	PostEvent(Event::Connected, socket);
+}
+
+void TCPIOThread::OnConnectFailed(TCPSocketPtr socket)
+{
+	PostEvent(Event::ConnectFailed, socket);
+}
@@ -0,0 +1,80 @@
+#ifndef TCP_IO_THREAD_H
+#define TCP_IO_THREAD_H
+
+/**
+ * Reactor thread owning a shard of the sockets of a TCPNetworkManager.
+ * The application thread posts commands (new sockets, packets to send,
+ * disconnections) and receives events (accepted sockets, packets,
+ * connections and disconnections) through lock-free SPSC queues, so
+ * socket I/O never runs in the application thread.
+ */
+class TCPIOThread : public TCPNetworkManager, public TCPNetworkManagerDelegate
+{
+public:
+
+	struct Event
+	{
+		enum Type { None, Accepted, Connected, ConnectFailed, PacketReceived, Disconnected };
+
+		Type type = None;
+		TCPSocketPtr socket;
+		std::vector<char> data; // Packet payload
+	};
+
+	TCPIOThread(SocketPollerType pollerType, int connectTimeoutMillis, uint32_t maxPacketSize);
+	~TCPIOThread();
+
+	void Start();
+
+	// It asks the thread to flush its sockets and exit (see IsFinished)
+	void RequestStop();
+	bool IsFinished() const { return mFinished; }
+	void Join();
+
+	// Application thread side
+	void PostAddSocket(const TCPSocketPtr &socket);
+	void PostSendPacket(const TCPSocketPtr &socket, const void *data, size_t size);
+	void PostDisconnect(const TCPSocketPtr &socket);
+	void FlushCommands();
+	bool PopEvent(Event &event);
+
+private:
+
+	struct Command
+	{
+		enum Type { None, AddSocket, SendPacket, Disconnect, Stop };
+
+		Type type = None;
+		TCPSocketPtr socket;
+		std::vector<char> data; // Packet payload
+	};
+
+	// I/O thread side
+	void Run();
+	bool HandleCommands(); // It returns false once asked to stop
+	void PostEvent(Event::Type type, const TCPSocketPtr &socket);
+	void FlushEvents();
+
+	// Commands are posted when the queue has room for them (never blocking),
+	// so the application and I/O threads cannot wait for each other
+	void PostCommand(Command &&command);
+
+	// TCPNetworkManagerDelegate (called from the I/O thread)
+	void OnAccepted(TCPSocketPtr socket) override;
+	void OnPacketReceived(TCPSocketPtr socket, InputMemoryStream &stream) override;
+	void OnDisconnected(TCPSocketPtr socket) override;
+	void OnConnected(TCPSocketPtr socket) override;
+	void OnConnectFailed(TCPSocketPtr socket) override;
+
+	std::thread mThread;
+	std::atomic<bool> mFinished; // Sockets flushed, thread exiting
+	std::atomic<bool> mAbort; // Exit right away (no consumer for the events)
+
+	SpscQueue<Command> mCommands;
+	std::deque<Command> mPendingCommands; // Waiting for room in mCommands
+
+	SpscQueue<Event> mEvents;
+	std::deque<Event> mPendingEvents; // Waiting for room in mEvents
+};
+
+#endif // TCP_IO_THREAD_H
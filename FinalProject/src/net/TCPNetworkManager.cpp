@@ -1,12 +1,19 @@
 #include "Net.h"
 #include "TCPNetworkManager.h"
+#include <algorithm> // std::find
 
 // Link with WinSockets library
 #pragma comment(lib, "ws2_32.lib")
 
 
-TCPNetworkManager::TCPNetworkManager() :
-	mDelegate(nullptr)
+TCPNetworkManager::TCPNetworkManager(SocketPollerType pollerType) :
+	mDelegate(nullptr),
+	mPoller(SocketPoller::Create(pollerType)),
+	mConnectTimeoutMillis(5000),
+	mMaxPacketSize(DEFAULT_MAX_PACKET_SIZE),
+	mPollerType(pollerType),
+	mIOThreadCount(0),
+	mNextIOThread(0)
 {
 }
 
@@ -21,94 +28,159 @@ void TCPNetworkManager::SetDelegate(TCPNetworkManagerDelegate * delegate)
 
 void TCPNetworkManager::AddSocket(TCPSocketPtr socket)
 {
+	if (mIOThreadCount > 0)
+	{
+		AddSocketToIOThread(socket);
+		return;
+	}
+
+	socket->mManager = this;
+	socket->mManagerIndex = mSockets.size();
+	socket->SetMaxPacketSize(mMaxPacketSize);
 	mSockets.push_back(socket);
+	mPoller->Add(socket);
+
+	if (socket->IsConnecting())
+	{
+		const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(mConnectTimeoutMillis);
+		mPendingConnections.push_back(PendingConnection(socket, deadline));
+	}
+
+	// Packets could have been queued before adding the socket
+	if (socket->HasOutgoingData() || socket->ToDisconnect())
+	{
+		TouchSocket(socket);
+	}
 }
 
 void TCPNetworkManager::HandleSocketOperations(int timeoutMillis)
 {
-	// Preselect sockets for reading and writing
-	std::vector<TCPSocketPtr> potentiallyReadableSockets;
-	std::vector<TCPSocketPtr> potentiallyWritableSockets;
-	for (auto socket : mSockets)
+	if (!mIOThreads.empty())
 	{
-		if (!socket->IsDisconnected())
-		{
-			potentiallyReadableSockets.push_back(socket);
-			if (socket->HasOutgoingData())
-			{
-				potentiallyWritableSockets.push_back(socket);
-			}
-		}
+		HandleIOThreadEvents();
+		return;
 	}
 
-	// Select readable and writable sockets
+	const bool edgeTriggered = mPoller->IsEdgeTriggered();
+
+	// Wait for readable and writable sockets
 	std::vector<TCPSocketPtr> readableSockets;
 	std::vector<TCPSocketPtr> writableSockets;
-	SocketUtil::Select(&potentiallyReadableSockets, &readableSockets, &potentiallyWritableSockets, &writableSockets, nullptr, nullptr, timeoutMillis);
+	mPoller->Poll(mSockets, readableSockets, writableSockets, timeoutMillis);
+
+	// Handle connections in progress (failures can be notified as readable)
+	for (auto &socket : writableSockets)
+	{
+		FinishConnect(socket);
+	}
+	for (auto &socket : readableSockets)
+	{
+		FinishConnect(socket);
+	}
+	HandleConnectTimeouts();
 
 	// Handle reading
-	for (auto socket : readableSockets)
+	for (auto &socket : readableSockets)
 	{
+		TouchSocket(socket);
+
+		if (socket->IsDisconnected())
+		{
+			continue; // Failed connections
+		}
+
 		if (socket->IsListening())
 		{
-			SocketAddress fromAddress;
-			TCPSocketPtr connectedSocket = socket->Accept(fromAddress);
-			if (connectedSocket != nullptr)
+			// Edge-triggered pollers notify once, so accept the whole backlog
+			do
 			{
-				mSockets.push_back(connectedSocket);
+				SocketAddress fromAddress;
+				TCPSocketPtr connectedSocket = socket->Accept(fromAddress);
+				if (connectedSocket == nullptr)
+				{
+					break;
+				}
+				AddSocket(connectedSocket);
 				mDelegate->OnAccepted(connectedSocket);
 			}
+			while (edgeTriggered);
 		}
 		else
 		{
-			socket->HandleIncomingData();
+			// Edge-triggered pollers notify once, so drain the socket
+			int recvBytes = 0;
+			do
+			{
+				recvBytes = socket->HandleIncomingData();
+			}
+			while (edgeTriggered && recvBytes > 0);
 
 			if (!socket->IsDisconnected())
 			{
-				// 1) Crear in InputMemoryStream
-				InputMemoryStream inputMemoryStream;
+				// The stream is a view of each packet inside the socket buffer
+				InputMemoryStream inputMemoryStream(nullptr, 0);
 
-				while (socket->ReceivePacket(inputMemoryStream.GetBufferPtr(), inputMemoryStream.GetCapacity()))
+				while (socket->ReceivePacket(inputMemoryStream))
 				{
 					mDelegate->OnPacketReceived(socket, inputMemoryStream);
-					inputMemoryStream.Clear();
 				}
 			}
 		}
 	}
 
+	// Edge-triggered pollers only notify writability again after the send
+	// buffer gets full, so data queued since the last call is sent right away
+	if (edgeTriggered)
+	{
+		for (auto &socket : mTouchedSockets)
+		{
+			if (socket->HasOutgoingData() && !socket->IsConnecting())
+			{
+				writableSockets.push_back(socket);
+			}
+		}
+	}
+
 	// Handle writing
-	for (auto socket : writableSockets)
+	for (auto &socket : writableSockets)
 	{
-		if (!socket->IsListening() && !socket->IsDisconnected()) // Maybe not needed... check
+		if (!socket->IsListening() && !socket->IsDisconnected() && !socket->IsConnecting() && socket->HasOutgoingData())
 		{
 			socket->HandleOutgoingData();
+			TouchSocket(socket);
 		}
 	}
 
 	// Handle socket disconnections
-	std::vector<TCPSocketPtr> connectedSockets;
-	for (auto socket : mSockets)
+	// Only sockets whose state changed since the last call are checked
+	std::vector<TCPSocketPtr> touchedSockets;
+	touchedSockets.swap(mTouchedSockets);
+	for (auto &socket : touchedSockets)
 	{
-		if (socket->ToDisconnect() && !socket->HasOutgoingData())
+		socket->mTouched = false;
+
+		if (socket->mManager != this)
 		{
-			socket->CloseSocket();
+			continue; // Already removed
 		}
 
-		if (socket->IsDisconnected())
+		const bool closeRequested = socket->ToDisconnect() && !socket->HasOutgoingData();
+		if (closeRequested || socket->IsDisconnected())
 		{
+			RemoveSocket(socket);
 			mDelegate->OnDisconnected(socket);
 		}
-		else
-		{
-			connectedSockets.push_back(socket);
-		}
 	}
-	mSockets.swap(connectedSockets);
 }
 
 void TCPNetworkManager::Finalize()
 {
+	if (!mIOThreads.empty())
+	{
+		FinalizeIOThreads();
+		return;
+	}
+
 	// Finish sending pending outgoing data
 	for (int i = 0; i < 100 ; ++i) {
 		bool pendingPackets = false;
@@ -126,11 +198,204 @@ void TCPNetworkManager::Finalize()
 
 	// Disconnect all sockets
 	for (auto socket : mSockets)
-		socket->Disconnect();
+		socket->RequestDisconnect();
 
 	// Handle last disconnections
 	HandleSocketOperations();
 
 	// Clear sockets
+	while (!mSockets.empty()) {
+		TCPSocketPtr socket = mSockets.back();
+		RemoveSocket(socket);
+	}
+	mTouchedSockets.clear();
+	mPendingConnections.clear();
+}
+
+void TCPNetworkManager::TouchSocket(const TCPSocketPtr &socket)
+{
+	if (!socket->mTouched)
+	{
+		socket->mTouched = true;
+		mTouchedSockets.push_back(socket);
+	}
+}
+
+void TCPNetworkManager::FinishConnect(const TCPSocketPtr &socket)
+{
+	if (!socket->IsConnecting())
+	{
+		return;
+	}
+
+	TouchSocket(socket);
+
+	const int error = socket->FinishConnect();
+	if (error == 0)
+	{
+		mDelegate->OnConnected(socket);
+	}
+	else
+	{
+		mDelegate->OnConnectFailed(socket);
+	}
+}
+
+void TCPNetworkManager::HandleConnectTimeouts()
+{
+	if (mPendingConnections.empty())
+	{
+		return;
+	}
+
+	const Clock::time_point now = Clock::now();
+	std::vector<PendingConnection> stillPending;
+	std::vector<TCPSocketPtr> expiredSockets;
+	for (auto &pending : mPendingConnections)
+	{
+		const TCPSocketPtr &socket = pending.first;
+		if (!socket->IsConnecting())
+		{
+			continue; // Already finished
+		}
+
+		if (now >= pending.second)
+		{
+			expiredSockets.push_back(socket);
+		}
+		else
+		{
+			stillPending.push_back(pending);
+		}
+	}
+	mPendingConnections.swap(stillPending);
+
+	// The delegate is notified once the list is updated, as it can connect again
+	for (auto &socket : expiredSockets)
+	{
+		TouchSocket(socket);
+		socket->AbortConnect();
+		mDelegate->OnConnectFailed(socket);
+	}
+}
+
+void TCPNetworkManager::RemoveSocket(const TCPSocketPtr &socket)
+{
+	// Unregister before closing, the descriptor could be reused afterwards
+	DetachSocket(socket);
+	socket->CloseSocket();
+}
+
+void TCPNetworkManager::DetachSocket(const TCPSocketPtr &socket)
+{
+	mPoller->Remove(socket);
+
+	socket->mManager = nullptr;
+	EraseSocket(socket);
+}
+
+void TCPNetworkManager::EraseSocket(const TCPSocketPtr &socket)
+{
+	// Swap with the last socket to remove in constant time
+	const size_t index = socket->mManagerIndex;
+	if (index >= mSockets.size() || mSockets[index] != socket)
+	{
+		return;
+	}
+	mSockets[index] = mSockets.back();
+	mSockets[index]->mManagerIndex = index;
+	mSockets.pop_back();
+}
+
+void TCPNetworkManager::AddSocketToIOThread(const TCPSocketPtr &socket)
+{
+	if (mIOThreads.empty())
+	{
+		for (int i = 0; i < mIOThreadCount; ++i)
+		{
+			mIOThreads.emplace_back(new TCPIOThread(mPollerType, mConnectTimeoutMillis, mMaxPacketSize));
+			mIOThreads.back()->Start();
+		}
+	}
+
+	// From now on the socket is only handled by its I/O thread
+	TCPIOThread *ioThread = mIOThreads[mNextIOThread++ % mIOThreads.size()].get();
+	socket->mIOThread = ioThread;
+	socket->mManagerIndex = mSockets.size();
+	mSockets.push_back(socket);
+	ioThread->PostAddSocket(socket);
+}
+
+void TCPNetworkManager::HandleIOThreadEvents()
+{
+	TCPIOThread::Event event;
+	for (auto &ioThread : mIOThreads)
+	{
+		ioThread->FlushCommands();
+
+		while (ioThread->PopEvent(event))
+		{
+			const TCPSocketPtr &socket = event.socket;
+			switch (event.type)
+			{
+			case TCPIOThread::Event::Accepted:
+				AddSocketToIOThread(socket);
+				mDelegate->OnAccepted(socket);
+				break;
+			case TCPIOThread::Event::Connected:
+				mDelegate->OnConnected(socket);
+				break;
+			case TCPIOThread::Event::ConnectFailed:
+				mDelegate->OnConnectFailed(socket);
+				break;
+			case TCPIOThread::Event::PacketReceived:
+			{
+				InputMemoryStream stream(event.data.data(), static_cast<uint32_t>(event.data.size()));
+				mDelegate->OnPacketReceived(socket, stream);
+				break;
+			}
+			case TCPIOThread::Event::Disconnected:
+			{
+				EraseSocket(socket);
+				mDelegate->OnDisconnected(socket);
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+}
+
+void TCPNetworkManager::FinalizeIOThreads()
+{
+	// Threads flush their sockets before exiting, and the last
+	// disconnections keep being dispatched meanwhile
+	for (auto &ioThread : mIOThreads)
+	{
+		ioThread->RequestStop();
+	}
+	bool running = true;
+	while (running)
+	{
+		HandleIOThreadEvents();
+
+		running = false;
+		for (auto &ioThread : mIOThreads)
+		{
+			running = running || !ioThread->IsFinished();
+		}
+		if (running)
+		{
+			std::this_thread::yield();
+		}
+	}
+	for (auto &ioThread : mIOThreads)
+	{
+		ioThread->Join();
+	}
+	HandleIOThreadEvents();
+
+	// Threads are kept (stopped) since sockets still point to them
 	mSockets.clear();
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include "Net.h"
 
+class TCPIOThread;
+
 class TCPNetworkManagerDelegate
 {
 public:
@@ -10,13 +12,17 @@ public:
 	virtual void OnAccepted(TCPSocketPtr socket) = 0;
 	virtual void OnPacketReceived(TCPSocketPtr socket, InputMemoryStream &stream) = 0;
 	virtual void OnDisconnected(TCPSocketPtr socket) = 0;
+
+	// Completion of connections started with TCPSocket::ConnectAsync
+	virtual void OnConnected(TCPSocketPtr) { }
+	virtual void OnConnectFailed(TCPSocketPtr) { }
 };
 
 class TCPNetworkManager
 {
 public:
 
-	TCPNetworkManager();
+	TCPNetworkManager(SocketPollerType pollerType = SocketPollerType::Default);
 	virtual ~TCPNetworkManager();
 
 	void SetDelegate(TCPNetworkManagerDelegate *delegate);
@@ -27,13 +33,64 @@ public:
 
 	void Finalize();
 
+	const char *GetPollerName() const { return mPoller->GetName(); }
+
+	// Time given to asynchronous connections before failing
+	void SetConnectTimeout(int timeoutMillis) { mConnectTimeoutMillis = timeoutMillis; }
+
+	// Maximum size of the packets received by the sockets added from now on
+	void SetMaxPacketSize(uint32_t maxPacketSize) { mMaxPacketSize = maxPacketSize; }
+
+	// Number of I/O threads (0 to handle sockets in the calling thread).
+	// Sockets are sharded across the threads, and their events are
+	// dispatched to the delegate from HandleSocketOperations.
+	// It must be set before adding any socket.
+	void SetIOThreadCount(int count) { mIOThreadCount = count; }
+	int GetIOThreadCount() const { return mIOThreadCount; }
+
 protected:
 
 	const std::vector<TCPSocketPtr> &allSockets() const { return mSockets; }
 
+	TCPNetworkManagerDelegate *GetDelegate() const { return mDelegate; }
+
+	// It removes a socket from the manager without closing it
+	void DetachSocket(const TCPSocketPtr &socket);
+
 private:
 
+	// Sockets notify the manager when their state changes
+	friend class TCPSocket;
+	void TouchSocket(const TCPSocketPtr &socket);
+
+	void RemoveSocket(const TCPSocketPtr &socket);
+
+	// It takes the socket out of mSockets (using its mManagerIndex)
+	void EraseSocket(const TCPSocketPtr &socket);
+
+	void FinishConnect(const TCPSocketPtr &socket);
+
+	void HandleConnectTimeouts();
+
+	// Versions of the public methods used when sockets live in I/O threads
+	void AddSocketToIOThread(const TCPSocketPtr &socket);
+	void HandleIOThreadEvents();
+	void FinalizeIOThreads();
+
 	TCPNetworkManagerDelegate *mDelegate;
 	std::vector<TCPSocketPtr> mSockets;
-};
 
+	std::unique_ptr<SocketPoller> mPoller;
+	std::vector<TCPSocketPtr> mTouchedSockets; /**< Sockets to check for disconnection. */
+
+	using Clock = std::chrono::steady_clock;
+	using PendingConnection = std::pair<TCPSocketPtr, Clock::time_point>;
+	std::vector<PendingConnection> mPendingConnections; /**< Connections in progress and their deadlines. */
+	int mConnectTimeoutMillis;
+	uint32_t mMaxPacketSize;
+
+	SocketPollerType mPollerType;
+	int mIOThreadCount;
+	size_t mNextIOThread; /**< Round-robin assignment of sockets to threads. */
+	std::vector<std::unique_ptr<TCPIOThread>> mIOThreads;
+};
@@ -1,5 +1,6 @@
 #include "Net.h"
 #include <cstdint>
+#include <algorithm> // std::max
 
 TCPSocket::~TCPSocket()
 {
@@ -42,7 +43,10 @@ TCPSocketPtr TCPSocket::Accept(SocketAddress &inFromAddress)
 	}
 	else
 	{
-		SocketUtil::ReportError("TCPSocket::Accept");
+		// Non-blocking listen sockets return no socket when the backlog is empty
+		if (SocketUtil::GetLastError() != WSAEWOULDBLOCK) {
+			SocketUtil::ReportError("TCPSocket::Accept");
+		}
 		return nullptr;
 	}
 }
@@ -59,6 +63,25 @@ int TCPSocket::Connect(const SocketAddress &inAddress)
 	return NO_ERROR;
 }
 
+int TCPSocket::ConnectAsync(const SocketAddress &inAddress)
+{
+	// The connection completes when the socket becomes writable
+	SetNonBlockingMode(true);
+	mRemoteAddress = inAddress;
+
+	int err = connect(mSocket, &inAddress.mSockAddr, inAddress.GetSize());
+	if (err < 0)
+	{
+		auto lastError = SocketUtil::GetLastError();
+		if (lastError != WSAEWOULDBLOCK && lastError != WSAEINPROGRESS) {
+			SocketUtil::ReportError("TCPSocket::ConnectAsync");
+			return -lastError;
+		}
+		mFlags |= FlagConnecting;
+	}
+	return NO_ERROR;
+}
+
 int TCPSocket::Send(const void *inData, int inLen)
 {
 	int bytesSentCount = send(mSocket, static_cast<const char*>(inData), inLen, 0);
@@ -74,6 +97,56 @@ int TCPSocket::Send(const void *inData, int inLen)
 	return bytesSentCount;
 }
 
+int TCPSocket::SendGather(const char *const inData[], const size_t inLens[], int inCount)
+{
+	// Several buffers sent with a single system call
+	const int MaxBuffers = 16;
+	assert(inCount <= MaxBuffers && "TCPSocket::SendGather() - too many buffers.");
+
+#ifdef _WIN32
+	WSABUF buffers[MaxBuffers];
+	for (int i = 0; i < inCount; ++i)
+	{
+		buffers[i].buf = const_cast<char*>(inData[i]);
+		buffers[i].len = static_cast<ULONG>(inLens[i]);
+	}
+	DWORD sentBytes = 0;
+	int bytesSentCount = SOCKET_ERROR;
+	if (WSASend(mSocket, buffers, inCount, &sentBytes, 0, nullptr, nullptr) == 0)
+	{
+		bytesSentCount = static_cast<int>(sentBytes);
+	}
+#else
+	struct iovec buffers[MaxBuffers];
+	for (int i = 0; i < inCount; ++i)
+	{
+		buffers[i].iov_base = const_cast<char*>(inData[i]);
+		buffers[i].iov_len = inLens[i];
+	}
+	struct msghdr message;
+	std::memset(&message, 0, sizeof(message));
+	message.msg_iov = buffers;
+	message.msg_iovlen = inCount;
+#ifdef MSG_NOSIGNAL
+	const int flags = MSG_NOSIGNAL; // Closed peers are handled as errors
+#else
+	const int flags = 0;
+#endif
+	int bytesSentCount = static_cast<int>(sendmsg(mSocket, &message, flags));
+#endif
+
+	if (bytesSentCount < 0)
+	{
+		auto lastError = SocketUtil::GetLastError();
+		if (lastError != WSAEWOULDBLOCK && lastError != WSAEINPROGRESS) {
+			SocketUtil::ReportError("TCPSocket::SendGather");
+			mFlags |= FlagDisconnected;
+		}
+		return -lastError;
+	}
+	return bytesSentCount;
+}
+
 int TCPSocket::Receive(void *inBuffer, int inLen)
 {
 	int bytesReceivedCount = recv(mSocket, static_cast<char*>(inBuffer), inLen, 0);
@@ -94,8 +167,21 @@ int TCPSocket::Receive(void *inBuffer, int inLen)
 }
 
 void TCPSocket::Disconnect()
+{
+	if (mIOThread != nullptr)
+	{
+		mIOThread->PostDisconnect(shared_from_this());
+	}
+	else
+	{
+		RequestDisconnect();
+	}
+}
+
+void TCPSocket::RequestDisconnect()
 {
 	mFlags |= FlagToDisconnect;
+	NotifyManager();
 }
 
 int TCPSocket::SetNonBlockingMode(bool inShouldBeNonBlocking)
@@ -133,108 +219,156 @@ int TCPSocket::SetReuseAddress(bool inShouldReuseAddress)
 
 void TCPSocket::SendPacket(const void *data, size_t size)
 {
-	// Resize outgoing data buffer
-	if (mOutgoingData.size() - mOutgoingDataHead < size + sizeof(uint32_t)) {
-		mOutgoingData.resize(mOutgoingData.size() + size + sizeof(uint32_t));
+	mPacketsSent++;
+	mBytesSent += size;
+
+	if (mIOThread != nullptr)
+	{
+		mIOThread->PostSendPacket(shared_from_this(), data, size);
 	}
+	else
+	{
+		QueuePacket(data, size);
+	}
+}
 
-	// Copy data size
-	*(uint32_t*)(&mOutgoingData[mOutgoingDataHead]) = static_cast<uint32_t>(size);
-	mOutgoingDataHead += sizeof(uint32_t);
+void TCPSocket::QueuePacket(const void *data, size_t size)
+{
+	// Copy data size and data
+	const uint32_t packetSize = static_cast<uint32_t>(size);
+	mOutgoingData.Reserve(size + sizeof(uint32_t));
+	mOutgoingData.Write(&packetSize, sizeof(uint32_t));
+	mOutgoingData.Write(data, size);
+	mHasOutgoingData = true;
 
-	// Copy data
-	memcpy((void*)&mOutgoingData[mOutgoingDataHead], data, size);
-	mOutgoingDataHead += size;
+	NotifyManager();
 }
 
-bool TCPSocket::ReceivePacket(void *data, size_t size)
+bool TCPSocket::ReceivePacket(InputMemoryStream &stream)
 {
-	bool read = false;
-	uint32_t writeHead = 0;
+	ConsumeIncomingPacket();
 
-	if (mIncomingDataRecvHead - mIncomingDataHead > sizeof(uint32_t))
+	if (mIncomingData.Size() < sizeof(uint32_t))
 	{
-		const uint32_t packetSize = *(uint32_t*)&mIncomingData[mIncomingDataHead];
-		const uint32_t availableSpaceInStream = (uint32_t)size - writeHead;
-		if (mIncomingDataRecvHead - (mIncomingDataHead + sizeof(uint32_t)) >= packetSize &&
-			packetSize <= availableSpaceInStream)
-		{
-			memcpy(
-				(void*)((char*)data + writeHead),
-				(const void*)&mIncomingData[mIncomingDataHead + sizeof(uint32_t)],
-				packetSize);
-			writeHead += packetSize;
-			mIncomingDataHead += packetSize + sizeof(uint32_t);
-			read = true;
-		}
+		return false;
 	}
 
-	if (!read)
+	uint32_t packetSize = 0;
+	mIncomingData.Peek(&packetSize, sizeof(uint32_t));
+	if (packetSize > mMaxPacketSize)
 	{
-		// Move heads to the beginning
-		if (mIncomingDataHead >= mIncomingDataRecvHead) {
-			mIncomingDataHead = 0;
-			mIncomingDataRecvHead = 0;
-		}
-		else {
-			size_t remainingBytes = mIncomingDataRecvHead - mIncomingDataHead;
-			memmove((void*)&mIncomingData[0], (const void*)&mIncomingData[mIncomingDataHead], remainingBytes);
-			mIncomingDataHead = 0;
-			mIncomingDataRecvHead = remainingBytes;
-		}
+		// The frame would never fit, so drop the connection instead of waiting
+		mFlags |= FlagDisconnected;
+		return false;
+	}
+	if (mIncomingData.Size() - sizeof(uint32_t) < packetSize)
+	{
+		return false;
 	}
 
-	return read;
+	// The stream reads the packet in place, it is consumed on the next call
+	mIncomingData.Consume(sizeof(uint32_t));
+	stream.SetView(mIncomingData.Linearize(packetSize), packetSize);
+	mIncomingPacketSize = packetSize;
+	mPacketsReceived++;
+	mBytesReceived += packetSize;
+	return true;
 }
 
 bool TCPSocket::HasOutgoingData() const
 {
-	return mOutgoingDataHead != mOutgoingDataSendHead;
+	return mHasOutgoingData;
 }
 
 void TCPSocket::HandleOutgoingData()
 {
-	const int sentBytes = Send((const void*)&mOutgoingData[mOutgoingDataSendHead], (int)(mOutgoingDataHead - mOutgoingDataSendHead));
+	// All queued packets are flushed at once, even if they wrap around
+	const char *segments[2];
+	size_t segmentSizes[2];
+	const int segmentCount = mOutgoingData.ReadSegments(segments, segmentSizes);
+
+	const int sentBytes = SendGather(segments, segmentSizes, segmentCount);
 	if (sentBytes > 0)
 	{
-		mOutgoingDataSendHead += sentBytes;
-
-		// Move heads to the beginning
-		if (mOutgoingDataSendHead >= mOutgoingDataHead) {
-			mOutgoingDataHead = 0;
-			mOutgoingDataSendHead = 0;
-		} else {
-			size_t remainingBytes = mOutgoingDataHead - mOutgoingDataSendHead;
-			memmove((void*)&mOutgoingData[0], (const void*)&mOutgoingData[mOutgoingDataSendHead], remainingBytes);
-			mOutgoingDataHead = remainingBytes;
-			mOutgoingDataSendHead = 0;
-		}
+		mOutgoingData.Consume(sentBytes);
+		mHasOutgoingData = !mOutgoingData.Empty();
 	}
 }
 
-void TCPSocket::HandleIncomingData()
+int TCPSocket::HandleIncomingData()
 {
-	// Resize incoming data buffer
-	const size_t size = 1500 * 10;
-	if (mIncomingData.size() - mIncomingDataRecvHead < size) {
-		mIncomingData.resize(mIncomingData.size() + size);
+	ConsumeIncomingPacket();
+
+	// Grow incoming data buffer (enough to complete the pending packet, so
+	// big packets are received without growing the buffer step by step)
+	size_t size = 1500 * 10;
+	if (mIncomingData.Size() >= sizeof(uint32_t))
+	{
+		uint32_t packetSize = 0;
+		mIncomingData.Peek(&packetSize, sizeof(uint32_t));
+		if (packetSize <= mMaxPacketSize)
+		{
+			const size_t frameSize = sizeof(uint32_t) + packetSize;
+			if (frameSize > mIncomingData.Size())
+			{
+				size = std::max(size, frameSize - mIncomingData.Size());
+			}
+		}
 	}
+	mIncomingData.Reserve(size);
 
-	const int recvBytes = Receive((void*)&mIncomingData[mIncomingDataRecvHead], size);
+	const int recvBytes = Receive(mIncomingData.WritePtr(), (int)mIncomingData.ContiguousWriteSize());
 	if (recvBytes > 0) {
-		mIncomingDataRecvHead += recvBytes;
+		mIncomingData.Commit(recvBytes);
 	}
+	return recvBytes;
+}
+
+void TCPSocket::ConsumeIncomingPacket()
+{
+	mIncomingData.Consume(mIncomingPacketSize);
+	mIncomingPacketSize = 0;
 }
 
 void TCPSocket::CloseSocket()
 {
-	if ((mFlags & FlagDisconnected) == 0)
+	// Sockets disconnected by the peer still own their descriptor
+	if ((mFlags & FlagClosed) == 0)
 	{
 #ifdef _WIN32
 		closesocket(mSocket);
 #else
 		close(mSocket);
 #endif
-		mFlags |= FlagDisconnected;
+		mFlags |= FlagDisconnected | FlagClosed;
+	}
+}
+
+int TCPSocket::FinishConnect()
+{
+	int error = 0;
+	socklen_t length = sizeof(error);
+	if (getsockopt(mSocket, SOL_SOCKET, SO_ERROR, (char*)&error, &length) == SOCKET_ERROR) {
+		error = SocketUtil::GetLastError();
+	}
+
+	mFlags &= ~FlagConnecting;
+	if (error != 0) {
+		mFlags |= FlagDisconnected | FlagConnectFailed;
+	}
+	return error;
+}
+
+void TCPSocket::AbortConnect()
+{
+	mFlags &= ~FlagConnecting;
+	mFlags |= FlagDisconnected | FlagConnectFailed;
+}
+
+void TCPSocket::NotifyManager()
+{
+	if (mManager != nullptr && !mTouched)
+	{
+		mManager->TouchSocket(shared_from_this());
 	}
 }
\ No newline at end of file
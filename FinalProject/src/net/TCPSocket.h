@@ -2,10 +2,13 @@
 #define TCP_SOCKET_H
 
 class TCPSocket;
+class TCPNetworkManager;
+class TCPIOThread;
+class InputMemoryStream;
 
 typedef std::shared_ptr<TCPSocket> TCPSocketPtr;
 
-class TCPSocket
+class TCPSocket : public std::enable_shared_from_this<TCPSocket>
 {
 public:
 
@@ -15,7 +18,9 @@ public:
 	int Listen(int inBackLog = 32);
 	TCPSocketPtr Accept(SocketAddress &inFromAddress);
 	int Connect(const SocketAddress &inAddress);
+	int ConnectAsync(const SocketAddress &inAddress);
 	int Send(const void *inData, int inLen);
+	int SendGather(const char *const inData[], const size_t inLens[], int inCount);
 	int Receive(void *inBuffer, int inLen);
 	void Disconnect();
 
@@ -25,53 +30,106 @@ public:
 	bool IsListening() const { return mFlags & FlagListening; }
 	bool ToDisconnect() const { return mFlags & FlagToDisconnect; }
 	bool IsDisconnected() const { return mFlags & FlagDisconnected; }
+	bool IsConnecting() const { return mFlags & FlagConnecting; }
+	bool ConnectFailed() const { return mFlags & FlagConnectFailed; }
 	const SocketAddress &RemoteAddress() { return mRemoteAddress; }
 
+	// Loopback sockets have no descriptor, their packets are delivered
+	// in memory by the owner of the socket (see SocketUtil::CreateLoopbackSocket)
+	bool IsLoopback() const { return (mFlags & FlagLoopback) != 0; }
+
 	// Use these methods instead of Send / Receive in conjunction with
 	// non-blocking methods (e.g. select)
+	// Sockets owned by an I/O thread forward the packet to that thread
 	void SendPacket(const void *data, size_t size);
-	bool ReceivePacket(void *data, size_t size);
+
+	// The stream becomes a view of the packet inside the receive buffer (no
+	// copies), valid until the next call to ReceivePacket/HandleIncomingData
+	bool ReceivePacket(InputMemoryStream &stream);
+
+	// Packets announcing a bigger size disconnect the socket
+	void SetMaxPacketSize(uint32_t inMaxPacketSize) { mMaxPacketSize = inMaxPacketSize; }
+	uint32_t MaxPacketSize() const { return mMaxPacketSize; }
 
 	// Use these methods instead of Send / Receive in conjunction with
 	// non-blocking methods (e.g. select)
 	bool HasOutgoingData() const;
 	void HandleOutgoingData();
-	void HandleIncomingData();
+	int HandleIncomingData();
+
+	// Traffic statistics (packets and payload bytes)
+	uint64_t PacketsSent() const { return mPacketsSent; }
+	uint64_t BytesSent() const { return mBytesSent; }
+	uint64_t PacketsReceived() const { return mPacketsReceived; }
+	uint64_t BytesReceived() const { return mBytesReceived; }
 
 private:
 
 	friend class SocketUtil;
+	friend class EpollSocketPoller;
 
 	// Only the network manager can call this explicitly
 	friend class TCPNetworkManager;
+	friend class TCPIOThread;
 	void CloseSocket();
 
+	// Local versions of SendPacket / Disconnect, run by the owner thread
+	void QueuePacket(const void *data, size_t size);
+	void RequestDisconnect();
+
+	// Completion of asynchronous connections (returns the socket error)
+	int FinishConnect();
+	void AbortConnect();
+
+	// Tells the owner manager that the state of this socket changed
+	void NotifyManager();
+
+	// Discards the packet last returned by ReceivePacket
+	void ConsumeIncomingPacket();
+
 	TCPSocket(SOCKET inSocket) :
 		mSocket(inSocket),
 		mFlags(0),
-		mOutgoingDataHead(0), mOutgoingDataSendHead(0),
-		mIncomingDataHead(0), mIncomingDataRecvHead(0)
+		mManager(nullptr), mManagerIndex(0), mTouched(false), mIOThread(nullptr),
+		mPacketsSent(0), mBytesSent(0), mPacketsReceived(0), mBytesReceived(0),
+		mHasOutgoingData(false),
+		mIncomingPacketSize(0), mMaxPacketSize(DEFAULT_MAX_PACKET_SIZE)
 	{ }
 
 	enum Flag {
 		FlagListening    = 1,
 		FlagDisconnected = 2,
-		FlagToDisconnect = 4
+		FlagToDisconnect = 4,
+		FlagClosed       = 8,
+		FlagConnecting   = 16,
+		FlagConnectFailed = 32,
+		FlagLoopback     = 64
 	};
 
 	SOCKET mSocket;
-	int mFlags;
+	std::atomic<int> mFlags; // Read by the application thread when using I/O threads
 	SocketAddress mRemoteAddress;
 
+	// Network manager bookkeeping
+	TCPNetworkManager *mManager; // Manager this socket was added to
+	size_t mManagerIndex; // Position in the manager socket array
+	bool mTouched; // Already queued for the next disconnection check
+	TCPIOThread *mIOThread; // I/O thread owning the socket (if any)
+
+	// Traffic statistics
+	std::atomic<uint64_t> mPacketsSent;
+	std::atomic<uint64_t> mBytesSent;
+	std::atomic<uint64_t> mPacketsReceived;
+	std::atomic<uint64_t> mBytesReceived;
+
 	// Data to be sent
-	size_t mOutgoingDataHead; // Accumulated
-	size_t mOutgoingDataSendHead; // Already sent
-	std::vector<char> mOutgoingData;
+	RingBuffer mOutgoingData;
+	std::atomic<bool> mHasOutgoingData; // Mirrors !mOutgoingData.Empty()
 
 	// Received data
-	size_t mIncomingDataHead; // To process
-	size_t mIncomingDataRecvHead; // Already read
-	std::vector<char> mIncomingData;
+	RingBuffer mIncomingData;
+	size_t mIncomingPacketSize; // Packet returned by ReceivePacket (not consumed yet)
+	uint32_t mMaxPacketSize; // Frames bigger than this are rejected
 };
 
 #endif // TCP_SOCKET_H
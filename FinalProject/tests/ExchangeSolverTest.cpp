@@ -0,0 +1,92 @@
+// Tests of the ExchangeSolver (see Test.h)
+
+#include "Test.h"
+#include "Globals.h"
+#include "ExchangeSolver.h"
+#include "Node.h"
+
+static void addItems(Node &node, uint16_t itemId, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		node.itemList().addItem(itemId);
+	}
+}
+
+// Three nodes, each one with a spare unit of the item wanted by the next one
+TEST(testTrilateralExchange)
+{
+	Node a(0), b(1), c(2);
+	addItems(a, 0, 2);
+	addItems(b, 1, 2);
+	addItems(c, 2, 2);
+
+	std::vector<ExchangeSolver::Offer> offers = {
+		{ nullptr, &a, 0, 1 },
+		{ nullptr, &b, 1, 2 },
+		{ nullptr, &c, 2, 0 }
+	};
+
+	ExchangeSolver solver;
+	std::vector<ExchangeSolver::Cycle> cycles;
+	solver.solve(offers, 3, cycles);
+	CHECK(cycles.size() == 1);
+	CHECK(cycles.size() == 1 && cycles[0] == ExchangeSolver::Cycle({ 0, 1, 2 }));
+
+	// Too long for the maximum length
+	cycles.clear();
+	solver.solve(offers, 2, cycles);
+	CHECK(cycles.empty());
+}
+
+// The first offer giving item 1 for item 2 is from node Q, which is also
+// the only one closing the cycle (3 -> 0), so the cycle needs the second
+// offer of the same pair (node R)
+TEST(testSecondOfferOfPairCompletesCycle)
+{
+	Node p(0), q(1), r(2), s(3);
+	addItems(p, 0, 2);
+	addItems(q, 1, 2);
+	addItems(q, 3, 2);
+	addItems(r, 1, 2);
+	addItems(s, 2, 2);
+
+	std::vector<ExchangeSolver::Offer> offers = {
+		{ nullptr, &p, 0, 1 },
+		{ nullptr, &q, 1, 2 },
+		{ nullptr, &r, 1, 2 },
+		{ nullptr, &s, 2, 3 },
+		{ nullptr, &q, 3, 0 }
+	};
+
+	ExchangeSolver solver;
+	std::vector<ExchangeSolver::Cycle> cycles;
+	solver.solve(offers, 4, cycles);
+	CHECK(cycles.size() == 1);
+	CHECK(cycles.size() == 1 && cycles[0] == ExchangeSolver::Cycle({ 0, 2, 3, 4 }));
+}
+
+// The same, but the blocked offer starts the search: Q would be needed
+// twice (1 -> 2 and 3 -> 4), while R can start the cycle instead
+TEST(testSecondStartOfPairCompletesCycle)
+{
+	Node q(0), r(1), s(2), v(3);
+	addItems(q, 1, 2);
+	addItems(q, 3, 2);
+	addItems(r, 1, 2);
+	addItems(s, 2, 2);
+	addItems(v, 4, 2);
+
+	std::vector<ExchangeSolver::Offer> offers = {
+		{ nullptr, &q, 1, 2 },
+		{ nullptr, &r, 1, 2 },
+		{ nullptr, &s, 2, 3 },
+		{ nullptr, &q, 3, 4 },
+		{ nullptr, &v, 4, 1 }
+	};
+
+	ExchangeSolver solver;
+	std::vector<ExchangeSolver::Cycle> cycles;
+	solver.solve(offers, 4, cycles);
+	CHECK(cycles.size() == 1);
+	CHECK(cycles.size() == 1 && cycles[0] == ExchangeSolver::Cycle({ 1, 2, 3, 4 }));
+}
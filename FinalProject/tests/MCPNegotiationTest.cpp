@@ -0,0 +1,208 @@
+// Tests of the negotiation fan-out of the MCP (see Test.h). The modules the
+// MCP talks to are replaced by the stubs below, which record the packets
+// sent by the agents.
+
+#include "Test.h"
+#include "Globals.h"
+#include "Application.h"
+#include "ModuleAgentContainer.h"
+#include "ModuleNetworkManager.h"
+#include "ModuleNodeCluster.h"
+#include "MCP.h"
+#include "UCP.h"
+#include "Log.h"
+
+Application *App = nullptr;
+
+
+// Stubs ///////////////////////////////////////////////////////////////
+
+/** Packet sent by an agent. */
+struct SentPacket
+{
+	PacketType packetType;
+	AgentId dstAgentId;
+};
+
+static std::vector<SentPacket> s_SentPackets;
+static std::vector<AgentLocation> s_DirectoryMCCs; /**< MCCs known by the MCCDirectory. */
+static int s_CreatedUCPs = 0;
+
+static void recordPacket(OutputMemoryStream &stream)
+{
+	InputMemoryStream headerStream(stream.GetBufferPtr(), stream.GetSize());
+	PacketHeader packetHead;
+	packetHead.Read(headerStream);
+	s_SentPackets.push_back({ packetHead.packetType, packetHead.dstAgentId });
+}
+
+Application::Application() { }
+Application::~Application() { }
+
+bool ModuleNetworkManager::init() { return true; }
+bool ModuleNetworkManager::preUpdate() { return true; }
+bool ModuleNetworkManager::postUpdate() { return true; }
+bool ModuleNetworkManager::stop() { return true; }
+bool ModuleNetworkManager::cleanUp() { return true; }
+bool ModuleNetworkManager::sendPacket(const std::string &, uint16_t, OutputMemoryStream &stream) { recordPacket(stream); return true; }
+bool ModuleNetworkManager::sendPacket(TCPSocketPtr, OutputMemoryStream &stream) { recordPacket(stream); return true; }
+bool ModuleNetworkManager::sendPacketToYellowPages(uint16_t, OutputMemoryStream &stream, bool) { recordPacket(stream); return true; }
+
+ModuleAgentContainer::ModuleAgentContainer() { }
+ModuleAgentContainer::~ModuleAgentContainer() { }
+bool ModuleAgentContainer::init() { return true; }
+bool ModuleAgentContainer::update() { return true; }
+bool ModuleAgentContainer::postUpdate() { return true; }
+bool ModuleAgentContainer::stop() { return true; }
+bool ModuleAgentContainer::cleanUp() { return true; }
+void ModuleAgentContainer::scheduleTimeout(Agent *, unsigned int) { }
+UCPPtr ModuleAgentContainer::createUCP(Node *node, uint16_t requestedItemId, uint16_t contributedItemId, const AgentLocation &uccLocation, unsigned int searchDepth)
+{
+	s_CreatedUCPs++;
+	return std::make_shared<UCP>(node, requestedItemId, contributedItemId, uccLocation, searchDepth);
+}
+
+bool ModuleNodeCluster::init() { return true; }
+bool ModuleNodeCluster::start() { return true; }
+bool ModuleNodeCluster::update() { return true; }
+bool ModuleNodeCluster::updateGUI() { return true; }
+bool ModuleNodeCluster::cleanUp() { return true; }
+bool ModuleNodeCluster::stop() { return true; }
+void ModuleNodeCluster::OnAccepted(TCPSocketPtr) { }
+void ModuleNodeCluster::OnPacketReceived(TCPSocketPtr, InputMemoryStream &) { }
+void ModuleNodeCluster::OnDisconnected(TCPSocketPtr) { }
+void ModuleNodeCluster::OnConnectFailed(TCPSocketPtr) { }
+
+UCP::UCP(Node *node, uint16_t, uint16_t, const AgentLocation &, unsigned int) : Agent(node) { }
+UCP::~UCP() { }
+void UCP::update() { }
+void UCP::stop() { }
+void UCP::OnPacketReceived(TCPSocketPtr, const PacketHeader &, InputMemoryStream &) { }
+void UCP::OnTimeout() { }
+bool UCP::negotiationClosed() { return false; }
+
+bool MCCDirectory::getMCCsForItem(uint16_t, std::vector<AgentLocation> &mccs)
+{
+	mccs = s_DirectoryMCCs;
+	return true;
+}
+
+
+// Helpers /////////////////////////////////////////////////////////////
+
+static const char *MCC_HOST = "127.0.0.1";
+
+static size_t countSent(PacketType packetType, AgentId dstAgentId)
+{
+	size_t count = 0;
+	for (auto &packet : s_SentPackets) {
+		if (packet.packetType == packetType && packet.dstAgentId == dstAgentId) {
+			count++;
+		}
+	}
+	return count;
+}
+
+// It delivers the answer of a MCC to a RequestForNegotiation
+static void answerNegotiation(MCP &mcp, AgentId mccId, bool success)
+{
+	TCPSocketPtr socket = SocketUtil::CreateLoopbackSocket(SocketAddress(INADDR_LOOPBACK, LISTEN_PORT_AGENTS));
+
+	PacketHeader packetHead;
+	packetHead.packetType = PacketType::ReturnForNegotiation;
+	packetHead.srcAgentId = mccId;
+	ResponseForNegotiation packetData;
+	packetData.success = success;
+	packetData.LocationUCC.hostIP = MCC_HOST;
+	packetData.LocationUCC.hostPort = LISTEN_PORT_AGENTS;
+	packetData.LocationUCC.agentId = mccId + 1000;
+
+	OutputMemoryStream outStream;
+	packetData.Write(outStream);
+	InputMemoryStream stream(outStream.GetBufferPtr(), outStream.GetSize());
+	mcp.OnPacketReceived(socket, packetHead, stream);
+}
+
+// It sets up the stubs of the modules used by the agents
+static void setUpApplication()
+{
+	static Application application;
+	static ModuleNetworkManager networkManager;
+	static ModuleAgentContainer agentContainer;
+	static ModuleNodeCluster nodeCluster;
+	if (App == nullptr)
+	{
+		SocketUtil::StaticInit();
+		g_Log.enableConsoleOutput(false);
+		application.networkManager = &networkManager;
+		application.agentContainer = &agentContainer;
+		application.modNodeCluster = &nodeCluster;
+		App = &application;
+	}
+}
+
+static void reset()
+{
+	setUpApplication();
+
+	s_SentPackets.clear();
+	s_DirectoryMCCs.clear();
+	s_CreatedUCPs = 0;
+
+	// More MCCs than requests sent at once
+	for (AgentId mccId = 1; mccId <= MCP_NEGOTIATION_FANOUT + 2; ++mccId)
+	{
+		AgentLocation mcc;
+		mcc.hostIP = MCC_HOST;
+		mcc.hostPort = LISTEN_PORT_AGENTS;
+		mcc.agentId = mccId;
+		s_DirectoryMCCs.push_back(mcc);
+	}
+}
+
+
+// Tests ///////////////////////////////////////////////////////////////
+
+// An acceptance arriving while the MCP asks more MCCs (after a rejection
+// freed a slot) is used, and the other requests are released
+TEST(testAcceptanceWhileIterating)
+{
+	reset();
+	Node node(0);
+	MCP mcp(&node, 1, 0, 0);
+
+	mcp.update(); // Directory hit
+	mcp.update(); // Requests to the first MCCs
+	CHECK(countSent(PacketType::RequestForNegotiation, 1) == 1);
+	CHECK(countSent(PacketType::RequestForNegotiation, MCP_NEGOTIATION_FANOUT + 1) == 0);
+
+	answerNegotiation(mcp, 1, false);
+	mcp.update(); // The free slot sends the MCP back to ask more MCCs
+	answerNegotiation(mcp, 2, true);
+
+	CHECK(s_CreatedUCPs == 1);
+	CHECK(countSent(PacketType::ReleaseNegotiation, 2) == 0);
+	for (AgentId mccId = 3; mccId <= MCP_NEGOTIATION_FANOUT; ++mccId) {
+		CHECK(countSent(PacketType::ReleaseNegotiation, mccId) == 1);
+	}
+
+	// No more requests once negotiating
+	mcp.update();
+	CHECK(countSent(PacketType::RequestForNegotiation, MCP_NEGOTIATION_FANOUT + 1) == 0);
+}
+
+// An acceptance arriving after the search finished is released
+TEST(testAcceptanceAfterFinishing)
+{
+	reset();
+	Node node(0);
+	MCP mcp(&node, 1, 0, 0);
+
+	mcp.update();
+	mcp.update();
+	mcp.commitExchange();
+	answerNegotiation(mcp, 1, true);
+
+	CHECK(s_CreatedUCPs == 0);
+	CHECK(countSent(PacketType::ReleaseNegotiation, 1) == 1);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdio>
+
+/**
+ * Minimal test framework of the SiSiMEXTests runner (TestMain.cpp).
+ * Tests are functions declared with TEST(name) in any file of the
+ * runner, and CHECK(condition) reports a failure without stopping
+ * the test:
+ *
+ *   TEST(testSomething)
+ *   {
+ *       CHECK(1 + 1 == 2);
+ *   }
+ */
+
+using TestFunction = void (*)();
+
+/** It adds a test to the runner (used by TEST). */
+struct TestRegistration
+{
+	TestRegistration(const char *name, TestFunction function);
+};
+
+/** Failed checks of the current run. */
+extern int g_TestFailures;
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			g_TestFailures++; \
+		} \
+	} while (0)
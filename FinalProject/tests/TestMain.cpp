@@ -0,0 +1,43 @@
+// Runner of the tests of SiSiMEX (console program, it returns 0 if all of
+// them pass). It is built by the SiSiMEXTests project of SiSiMEX.sln, which
+// runs it after each build, so failing tests fail the build.
+
+#include "Test.h"
+#include "Globals.h"
+#include <vector>
+
+SimulationConfig g_Config;
+
+int g_TestFailures = 0;
+
+struct Test
+{
+	const char *name;
+	TestFunction function;
+};
+
+// Registered from the static initializers of every file, so it is
+// created on first use
+static std::vector<Test> &tests()
+{
+	static std::vector<Test> allTests;
+	return allTests;
+}
+
+TestRegistration::TestRegistration(const char *name, TestFunction function)
+{
+	tests().push_back({ name, function });
+}
+
+int main()
+{
+	for (auto &test : tests())
+	{
+		const int failuresBefore = g_TestFailures;
+		test.function();
+		printf("%s %s\n", g_TestFailures == failuresBefore ? "[ OK ]" : "[FAIL]", test.name);
+	}
+
+	printf("%d tests, %d failed checks\n", (int)tests().size(), g_TestFailures);
+	return g_TestFailures == 0 ? 0 : 1;
+}